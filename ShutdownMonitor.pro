@@ -28,25 +28,46 @@ TEMPLATE = app              # Make an executable
 }
 
 QT += x11extras
-QT += widgets
+QT += gui
 CONFIG += c++17
 
 # The user interface:
 !equals(CONSOLE, no) {
     message("Include command-line interface")
     DEFINES += SHUTDOWN_MONITOR_CONSOLE
+    QT += network
+
+    HEADERS +=  qmonitorserver.h \
+                qmonitorclient.h
+    SOURCES +=  qmonitorserver.cpp \
+                qmonitorclient.cpp
 }
 !equals(SYSTRAY, no) {
     message("Include system tray interface")
     DEFINES += SHUTDOWN_MONITOR_SYSTRAY
+    QT += widgets
+
+    HEADERS +=  qtraymenu.h \
+                qscreenresourcesworker.h
+    SOURCES +=  qtraymenu.cpp \
+                qscreenresourcesworker.cpp
 }
 
 # The headers and source files:
 HEADERS +=  qscreenresources.h \
-            qoutput.h
+            qoutput.h \
+            qoutputlayout.h \
+            qoutputstorage.h \
+            qstats.h \
+            qtracer.h \
+            qtypedscreenresources.h
 SOURCES +=  main.cpp \
             qscreenresources.cpp \
             qoutput.cpp \
+            qoutputlayout.cpp \
+            qoutputstorage.cpp \
+            qstats.cpp \
+            qtracer.cpp \
             qscreenresourcesfactory.cpp
 
 # The backends:
@@ -70,12 +91,19 @@ BACKEND_INSERT=
     message("Include X11 backend")
     BACKEND_INCLUDES += xrrscreenresources.h
     BACKEND_INSERT += XRandRScreenResources
-    LIBS += -lXrandr -lX11
+    DEFINES += SHUTDOWN_MONITOR_X11
+    LIBS += -lXrandr -lX11 -lX11-xcb -lxcb-randr -lxcb
 
-    HEADERS +=  xrrscreenresources.h \
+    HEADERS +=  randrscreenresources.h \
+                randroutput.h \
+                randrcrtc.h \
+                xrrscreenresources.h \
                 xrroutput.h \
                 xrrcrtc.h
-    SOURCES +=  xrrscreenresources.cpp \
+    SOURCES +=  randrscreenresources.cpp \
+                randroutput.cpp \
+                randrcrtc.cpp \
+                xrrscreenresources.cpp \
                 xrroutput.cpp \
                 xrrcrtc.cpp
 }
@@ -92,7 +120,7 @@ BACKEND_INCLUDES=$$join(BACKEND_INCLUDES, "\"$${NL}$${LITERAL_HASH}include \"",
 
 BACKEND_INSERT_LINES=
 for(B, BACKEND_INSERT) {
-    BACKEND_INSERT_LINES+="    availableBackends.append(qMakePair($${B}::name, &$${B}::create));"
+    BACKEND_INSERT_LINES+="    availableBackends.append(backend<$${B}>());"
 }
 BACKEND_INSERT=$$join(BACKEND_INSERT_LINES, "$${NL}")
 
@@ -0,0 +1,329 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "qscreenresources.h"
+#include "qoutput.h"
+#include "qstats.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <QtDebug>
+
+#include <algorithm>
+#include <iostream>
+
+/*!
+ * \brief Benchmark measurement
+ *
+ * Instances of this class accumulate the durations and
+ * the number of requests of a benchmarked operation.
+ */
+class Measurement
+{
+public:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the measurement with the given name.
+     * \param name The name of the benchmarked operation.
+     */
+    inline Measurement(const QString& name) :
+        name(name) {}
+
+    /*!
+     * \brief Add a sample
+     *
+     * Add a new sample to the measurement.
+     * \param duration The duration of the operation (in ns).
+     * \param requests The number of requests issued by the operation.
+     */
+    inline void add(qint64 duration, qint64 requests) {mDurations.append(duration); mRequests.append(requests);}
+    /*!
+     * \brief Print the measurement
+     *
+     * Print the statistics of the measurement on the standard output.
+     */
+    void print(void) const;
+    /*!
+     * \brief Convert to JSON
+     *
+     * Convert the statistics of the measurement to a JSON object.
+     * \return The statistics of the measurement as a JSON object.
+     */
+    QJsonObject toJson(void) const;
+
+    QString name;   /*!< The name of the benchmarked operation */
+private:
+    /*!
+     * \brief Percentile of the durations
+     *
+     * Compute the given percentile of the durations.
+     * \param p The percentile (between 0 and 100).
+     * \return The given percentile of the durations (in ns).
+     */
+    qint64 percentile(int p) const;
+
+    QList<qint64> mDurations;   /*!< The durations of the operation (in ns) */
+    QList<qint64> mRequests;    /*!< The numbers of requests issued by the operation */
+};
+
+qint64 Measurement::percentile(int p) const
+{
+    if (mDurations.isEmpty())
+        return 0;
+
+    QList<qint64> durations = mDurations;
+    std::sort(durations.begin(), durations.end());
+    return durations.at(qMin(durations.size() - 1, (p * durations.size()) / 100));
+}
+
+void Measurement::print(void) const
+{
+    std::cout << qPrintable(name.leftJustified(16))
+              << " min: "    << qPrintable(QString::number(percentile(0) / 1000.0, 'f', 1).rightJustified(10)) << " us"
+              << " median: " << qPrintable(QString::number(percentile(50) / 1000.0, 'f', 1).rightJustified(10)) << " us"
+              << " p99: "    << qPrintable(QString::number(percentile(99) / 1000.0, 'f', 1).rightJustified(10)) << " us"
+              << " requests: " << (mRequests.isEmpty() ? 0 : mRequests.last()) << std::endl;
+}
+
+QJsonObject Measurement::toJson(void) const
+{
+    QJsonObject json;
+    json.insert("samples", mDurations.size());
+    json.insert("min_ns", percentile(0));
+    json.insert("median_ns", percentile(50));
+    json.insert("p99_ns", percentile(99));
+    json.insert("requests", mRequests.isEmpty() ? 0 : mRequests.last());
+    return json;
+}
+
+/*!
+ * \brief Measure an operation
+ *
+ * Measure the duration and the number of requests of the given operation.
+ * The requests are the ones counted by the backend in QStats,
+ * as the backends may use their own connection to the display server.
+ * \param measurement The measurement to add the sample to.
+ * \param operation The operation to measure.
+ */
+void measure(Measurement& measurement, const std::function<void(void)>& operation)
+{
+    QElapsedTimer timer;
+
+    quint64 requests = QStats::requestCount();
+    timer.start();
+    operation();
+    qint64 duration = timer.nsecsElapsed();
+    measurement.add(duration, QStats::requestCount() - requests);
+}
+
+/*!
+ * \brief Connected enabled outputs
+ *
+ * List the connected outputs which are enabled.
+ * \param resources The screen resources.
+ * \return The list of the connected enabled outputs.
+ */
+QList<QOutput*> enabledOutputs(QScreenResources* resources)
+{
+    QList<QOutput*> ans;
+
+    for (QOutput* output : resources->outputs()) {
+        if (output->connection != QOutput::Connection::Connected)
+            continue;
+        if (output->enabled())
+            ans << output;
+    }
+
+    return ans;
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+    QGuiApplication::setApplicationName("ShutdownMonitorBenchmark");
+
+    // Setup command line arguments parser:
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.setApplicationDescription(QObject::tr("Measure the latency of ShutdownMonitor backends."));
+    parser.addOption(QCommandLineOption("backend", QObject::tr("The backend to benchmark."), QObject::tr("backend"), "X11"));
+    parser.addOption(QCommandLineOption("iterations", QObject::tr("The number of iterations of each measurement."), QObject::tr("iterations"), "100"));
+    parser.addOption(QCommandLineOption("output", QObject::tr("The JSON file where to write the results."), QObject::tr("file")));
+    parser.process(app);
+
+    bool ok;
+    int iterations = parser.value("iterations").toInt(&ok);
+    if (!ok || (iterations <= 0)) {
+        qWarning() << QObject::tr("Invalid number of iterations: %1").arg(parser.value("iterations"));
+        return -1;
+    }
+
+    // The request counts come from QStats:
+    QStats::setEnabled(true);
+
+    Measurement create("create");
+    Measurement refresh("refresh");
+    Measurement toggle("toggle");
+    Measurement restore("restore");
+    Measurement blank("blank");
+    Measurement unblank("unblank");
+    Measurement multiToggle("multi-toggle");
+    Measurement multiRestore("multi-restore");
+    Measurement grabToggle("grab-toggle");
+    Measurement grabRestore("grab-restore");
+
+    // Backend creation:
+    for (int i = 0; i < iterations; i++) {
+        QScreenResources* resources = nullptr;
+        measure(create, [&resources, &parser] {
+            resources = QScreenResources::create(parser.value("backend"));
+            if (resources != nullptr)
+                resources->outputs();
+        });
+        delete resources;
+        if (resources == nullptr) {
+            qWarning() << QObject::tr("Backend %1 is not available").arg(parser.value("backend"));
+            return -2;
+        }
+    }
+
+    QScreenResources* resources = QScreenResources::create(parser.value("backend"));
+    resources->outputs();
+    QList<QOutput*> outputs = enabledOutputs(resources);
+    std::cout << qPrintable(QObject::tr("Benchmarking backend %1 with %2 enabled outputs").arg(resources->name).arg(outputs.size())) << std::endl;
+
+    // Output list refresh:
+    for (int i = 0; i < iterations; i++)
+        measure(refresh, [resources] {
+            resources->outputs(true);
+        });
+    outputs = enabledOutputs(resources);
+
+    // Single output toggle and restore:
+    if (outputs.size() > 1) {
+        QOutputId outputId = outputs.last()->id;
+        for (int i = 0; i < iterations; i++) {
+            measure(toggle, [resources, outputId] {
+                resources->output(outputId)->toggle();
+            });
+            QCoreApplication::processEvents();
+            measure(restore, [resources, outputId] {
+                resources->output(outputId)->enable();
+            });
+            QCoreApplication::processEvents();
+        }
+    }
+
+    // Single output blank and unblank (the layout is not changed):
+    if (resources->canBlank() && !outputs.isEmpty()) {
+        QOutputId outputId = outputs.last()->id;
+        for (int i = 0; i < iterations; i++) {
+            measure(blank, [resources, outputId] {
+                resources->output(outputId)->blank();
+            });
+            QCoreApplication::processEvents();
+            measure(unblank, [resources, outputId] {
+                resources->output(outputId)->unblank();
+            });
+            QCoreApplication::processEvents();
+        }
+    }
+
+    // Multiple outputs toggle and restore:
+    if (outputs.size() > 2) {
+        QOutputChanges disable;
+        QOutputChanges enable;
+        foreach (QOutput* output, outputs.mid(1)) {
+            disable.insert(output->id, false);
+            enable.insert(output->id, true);
+        }
+        for (int i = 0; i < iterations; i++) {
+            measure(multiToggle, [resources, &disable] {
+                resources->applyChanges(disable);
+            });
+            QCoreApplication::processEvents();
+            measure(multiRestore, [resources, &enable] {
+                resources->applyChanges(enable);
+            });
+            QCoreApplication::processEvents();
+        }
+    }
+
+    // Multiple outputs toggle and restore while the server is grabbed:
+    qint64 grabMax = -1;
+    if (outputs.size() > 1) {
+        QOutputChanges disable;
+        QOutputChanges enable;
+        foreach (QOutput* output, outputs.mid(1)) {
+            disable.insert(output->id, false);
+            enable.insert(output->id, true);
+        }
+        QStats::reset();
+        for (int i = 0; i < iterations; i++) {
+            measure(grabToggle, [resources, &disable] {
+                resources->applyChanges(disable, true);
+            });
+            QCoreApplication::processEvents();
+            measure(grabRestore, [resources, &enable] {
+                resources->applyChanges(enable, true);
+            });
+            QCoreApplication::processEvents();
+        }
+        grabMax = QStats::maxDuration("GrabServer");
+    }
+
+    // Report results:
+    QList<Measurement*> measurements;
+    measurements << &create << &refresh << &toggle << &restore << &blank << &unblank << &multiToggle << &multiRestore << &grabToggle << &grabRestore;
+
+    QJsonObject results;
+    foreach (Measurement* measurement, measurements) {
+        measurement->print();
+        results.insert(measurement->name, measurement->toJson());
+    }
+    if (grabMax >= 0)
+        std::cout << qPrintable(QObject::tr("Maximum server grab time: %1 us").arg(grabMax / 1000.0, 0, 'f', 1)) << std::endl;
+
+    if (parser.isSet("output")) {
+        QJsonObject json;
+        json.insert("backend", resources->name);
+        json.insert("outputs", outputs.size());
+        json.insert("iterations", iterations);
+        json.insert("results", results);
+        if (grabMax >= 0)
+            json.insert("grab_max_ns", grabMax);
+
+        QFile file(parser.value("output"));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << QObject::tr("Could not open output file: %1").arg(parser.value("output"));
+            delete resources;
+            return -3;
+        }
+        file.write(QJsonDocument(json).toJson());
+    }
+
+    delete resources;
+    return 0;
+}
@@ -0,0 +1,126 @@
+#!/bin/sh
+# Copyright 2024 Pascal COMBES <pascom@orange.fr>
+#
+# This file is part of ShutdownMonitor.
+#
+# ShutdownMonitor is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# ShutdownMonitor is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+
+# Runs the benchmark against a private X server.
+# Usage: run-benchmark.sh <benchmark> <output.json> [backends] [heads] [shutdownmonitor]
+# The backends are separated by commas (e.g. "X11,XCB") and are all measured
+# against the same server, so that their latencies can be compared.
+# With several backends, the output of each one is written
+# next to the output file (with a -<backend> suffix).
+# When heads is greater than 1, Xorg with the dummy video driver is used
+# (xf86-video-dummy 0.4 or later is required), otherwise Xvfb is used.
+# When the COMPOSITOR environment variable is set (e.g. "sway -c /dev/null"),
+# the benchmark runs against this Wayland compositor instead, started headless
+# with the given number of heads (wlroots headless backend and pixman renderer).
+# When the shutdownmonitor executable is given, the cold start time and
+# the peak RSS of "shutdownmonitor -l" are also measured (with GNU time)
+# and written next to the output file (with a -startup.json suffix).
+
+set -e
+
+BENCHMARK="$1"
+OUTPUT="$2"
+BACKEND="${3:-X11}"
+HEADS="${4:-1}"
+CLI="$5"
+ITERATIONS="${ITERATIONS:-100}"
+DISPLAY_NUMBER="${DISPLAY_NUMBER:-99}"
+
+if [ -z "$BENCHMARK" ] || [ -z "$OUTPUT" ]; then
+    echo "Usage: $0 <benchmark> <output.json> [backends] [heads] [shutdownmonitor]" >&2
+    exit 1
+fi
+
+WORKDIR="$(mktemp -d)"
+trap 'kill "$SERVER_PID" 2>/dev/null || true; rm -rf "$WORKDIR"' EXIT
+
+if [ -n "$COMPOSITOR" ]; then
+    mkdir -m 700 "$WORKDIR/runtime"
+    XDG_RUNTIME_DIR="$WORKDIR/runtime" WLR_BACKENDS=headless WLR_RENDERER=pixman \
+        WLR_HEADLESS_OUTPUTS="$HEADS" WLR_LIBINPUT_NO_DEVICES=1 \
+        $COMPOSITOR > "$WORKDIR/compositor.log" 2>&1 &
+    SERVER_PID=$!
+
+    # Wait for the compositor to create its socket:
+    for i in $(seq 50); do
+        SOCKET="$(ls "$WORKDIR/runtime" | grep '^wayland-[0-9]*$' | head -n 1)"
+        [ -n "$SOCKET" ] && break
+        sleep 0.1
+    done
+    RUN_ENV="XDG_RUNTIME_DIR=$WORKDIR/runtime WAYLAND_DISPLAY=$SOCKET QT_QPA_PLATFORM=wayland"
+else
+    if [ "$HEADS" -gt 1 ]; then
+        cat > "$WORKDIR/xorg.conf" <<CONF
+Section "Device"
+    Identifier "dummy"
+    Driver "dummy"
+    VideoRam 256000
+    Option "NumHeads" "$HEADS"
+EndSection
+
+Section "Screen"
+    Identifier "screen"
+    Device "dummy"
+    DefaultDepth 24
+    SubSection "Display"
+        Depth 24
+        Virtual 8192 4096
+    EndSubSection
+EndSection
+CONF
+        Xorg ":$DISPLAY_NUMBER" -noreset -nolisten tcp -config "$WORKDIR/xorg.conf" \
+             -logfile "$WORKDIR/Xorg.log" &
+    else
+        Xvfb ":$DISPLAY_NUMBER" -noreset -nolisten tcp -screen 0 1920x1080x24 &
+    fi
+    SERVER_PID=$!
+
+    # Wait for the server to accept connections:
+    for i in $(seq 50); do
+        [ -e "/tmp/.X11-unix/X$DISPLAY_NUMBER" ] && break
+        sleep 0.1
+    done
+
+    RUN_ENV="DISPLAY=:$DISPLAY_NUMBER QT_QPA_PLATFORM=xcb"
+fi
+
+for B in $(echo "$BACKEND" | tr ',' ' '); do
+    if [ "$B" = "$BACKEND" ]; then
+        BACKEND_OUTPUT="$OUTPUT"
+    else
+        BACKEND_OUTPUT="${OUTPUT%.json}-$B.json"
+    fi
+    env $RUN_ENV "$BENCHMARK" --backend "$B" --iterations "$ITERATIONS" --output "$BACKEND_OUTPUT"
+
+    # Measure the command-line tool start-up:
+    if [ -n "$CLI" ] && [ -x /usr/bin/time ]; then
+        STARTUP="${BACKEND_OUTPUT%.json}-startup.json"
+        rm -f "$WORKDIR/startup.txt"
+        for i in $(seq "$ITERATIONS"); do
+            env $RUN_ENV /usr/bin/time -f "%e %M" -a -o "$WORKDIR/startup.txt" \
+                "$CLI" --backend "$B" -l > /dev/null
+        done
+        sort -n "$WORKDIR/startup.txt" | awk -v backend="$B" '
+            { time[NR] = $1 * 1000; if ($2 > rss) rss = $2 }
+            END {
+                printf "{\n    \"backend\": \"%s\",\n", backend
+                printf "    \"startup_ms\": {\"min\": %d, \"median\": %d, \"max\": %d},\n", time[1], time[int((NR + 1) / 2)], time[NR]
+                printf "    \"peak_rss_kb\": %d\n}\n", rss
+            }' > "$STARTUP"
+    fi
+done
@@ -24,6 +24,7 @@
 KScreenOutput::KScreenOutput(KScreenResources* parent, const KScreen::OutputPtr& output)
     : QOutput(parent), mOutput(output)
 {
+    id = !output.isNull() ? output->id() : 0;
     physicalWidth = !output.isNull() ? output->sizeMm().width() : 0;
     physicalHeight = !output.isNull() ? output->sizeMm().height() : 0;
     name = !output.isNull() ? output->name() : QString();
@@ -42,6 +43,9 @@ KScreenOutput::KScreenOutput(KScreenResources* parent, const KScreen::OutputPtr&
 
 void KScreenOutput::update(const KScreen::OutputPtr& output)
 {
+    if (!output.isNull())
+        mOutput = output;
+
     if (!output.isNull() && output->isEnabled()) {
         if (output->isConnected())
             connection = QOutput::Connection::Connected;
@@ -56,7 +56,7 @@ private:
      * \brief Update the output
      *
      * This function actualizes the properties of the output.
-     * \note Currently only the connection state is updated.
+     * \note Currently only the KScreen output and the connection state are updated.
      * \param output The output from KScreen
      */
     void update(const KScreen::OutputPtr& output);
@@ -18,9 +18,14 @@
 
 #include "kscreenresources.h"
 #include "kscreenoutput.h"
+#include "qstats.h"
+#include "qtracer.h"
 
+#include <QDataStream>
+#include <QElapsedTimer>
 #include <QtDebug>
 
+#include <KScreen/ConfigMonitor>
 #include <KScreen/GetConfigOperation>
 #include <KScreen/SetConfigOperation>
 
@@ -36,6 +41,26 @@ QScreenResources* KScreenResources::create(bool forceBackend)
     return KScreenResources::getCurrent();
 }
 
+void KScreenResources::probe(bool forceBackend, const QProbeCallback& callback)
+{
+    Q_UNUSED(forceBackend);
+
+    QString operation = QStats::currentOperation();
+    QElapsedTimer timer;
+    timer.start();
+    KScreen::GetConfigOperation* opGet = new KScreen::GetConfigOperation(KScreen::ConfigOperation::NoOptions);
+    QObject::connect(opGet, &KScreen::ConfigOperation::finished, opGet, [callback, operation, timer] (KScreen::ConfigOperation* op) {
+        QStats::count(operation, "GetConfigOperation", timer.nsecsElapsed());
+        KScreen::ConfigPtr config = qobject_cast<KScreen::GetConfigOperation*>(op)->config();
+        if (op->hasError() || config.isNull()) {
+            qWarning() << QObject::tr("Could not retrieve current config. Error:") << op->errorString();
+            callback(nullptr);
+        } else {
+            callback(new KScreenResources(config));
+        }
+    });
+}
+
 KScreenResources *KScreenResources::getCurrent()
 {
     KScreen::ConfigPtr config = getConfig();
@@ -48,8 +73,13 @@ KScreenResources *KScreenResources::getCurrent()
 
 KScreen::ConfigPtr KScreenResources::getConfig(void)
 {
+    QTraceScope trace("getConfigOperation");
+    QElapsedTimer timer;
+    timer.start();
     KScreen::GetConfigOperation* opGet = new KScreen::GetConfigOperation(KScreen::ConfigOperation::NoOptions);
-    if (opGet->exec())
+    bool ok = opGet->exec();
+    QStats::count("GetConfigOperation", timer.nsecsElapsed());
+    if (ok)
         return opGet->config();
 
     qWarning() << QObject::tr("Could not retrieve current config. Error:") << opGet->errorString();
@@ -58,8 +88,13 @@ KScreen::ConfigPtr KScreenResources::getConfig(void)
 
 bool KScreenResources::setConfig(const KScreen::ConfigPtr& config)
 {
+    QTraceScope trace("setConfigOperation");
+    QElapsedTimer timer;
+    timer.start();
     KScreen::SetConfigOperation* opSet = new KScreen::SetConfigOperation(config);
-    if (opSet->exec())
+    bool ok = opSet->exec();
+    QStats::count("SetConfigOperation", timer.nsecsElapsed());
+    if (ok)
         return true;
 
     qWarning() << QObject::tr("Could not set config. Error:") << opSet->errorString();
@@ -67,227 +102,273 @@ bool KScreenResources::setConfig(const KScreen::ConfigPtr& config)
 }
 
 KScreenResources::KScreenResources(const KScreen::ConfigPtr& config)
-    : QScreenResources(KScreenResources::name)
+    : QTypedScreenResources<KScreenOutput>(KScreenResources::name)
+{
+    setLiveConfig(config);
+}
+
+KScreenResources::~KScreenResources(void)
 {
-    mOutputs.clear();
-    refreshOutputs(config);
+    QObject::disconnect(mConfigConnection);
+    KScreen::ConfigMonitor::instance()->removeConfig(mConfig);
 }
 
+void KScreenResources::setLiveConfig(const KScreen::ConfigPtr& config)
+{
+    if (!mConfig.isNull()) {
+        QObject::disconnect(mConfigConnection);
+        KScreen::ConfigMonitor::instance()->removeConfig(mConfig);
+    }
+
+    mConfig = config;
+    refreshOutputs(mConfig);
+
+    // Keep the configuration up to date:
+    KScreen::ConfigMonitor::instance()->addConfig(mConfig);
+    mConfigConnection = QObject::connect(KScreen::ConfigMonitor::instance(), &KScreen::ConfigMonitor::configurationChanged, mConfig.data(), [this] {
+        refreshOutputs(mConfig);
+    });
+}
 
 void KScreenResources::refreshOutputs(void)
 {
-    KScreen::ConfigPtr config = getConfig();
-    if (config.isNull())
-        return;
+    refreshOutputs(mConfig);
+}
 
-    refreshOutputs(config);
+void KScreenResources::refreshOutputsAsync(const std::function<void(void)>& callback)
+{
+    QStatsOperation stats("refresh");
+    QString operation = QStats::currentOperation();
+    QElapsedTimer timer;
+    timer.start();
+    qint64 traceBegin = QTracer::isEnabled() ? QTracer::now() : 0;
+    KScreen::GetConfigOperation* opGet = new KScreen::GetConfigOperation(KScreen::ConfigOperation::NoOptions);
+    QObject::connect(opGet, &KScreen::ConfigOperation::finished, &mContext, [this, callback, traceBegin, operation, timer] (KScreen::ConfigOperation* op) {
+        QStats::count(operation, "GetConfigOperation", timer.nsecsElapsed());
+        if (QTracer::isEnabled())
+            QTracer::record("getConfigOperation", traceBegin, QTracer::now());
+        if (op->hasError())
+            qWarning() << QObject::tr("Could not retrieve current config. Error:") << op->errorString();
+        else
+            setLiveConfig(qobject_cast<KScreen::GetConfigOperation*>(op)->config());
+        callback();
+    });
 }
 
 void KScreenResources::refreshOutputs(const KScreen::ConfigPtr& config)
 {
-    QList<QOutputId> deletedIds;
+    QTraceScope trace("refreshOutputs");
+    QStatsOperation stats("refresh");
+    QSet<QOutputId> outputIds;
 
     // Update outputs and create new ones:
     for (KScreen::OutputPtr output : config->outputs()) {
-        KScreenOutput* kOutput = dynamic_cast<KScreenOutput*>(mOutputs.value(output->id()));
+        outputIds.insert(output->id());
+        KScreenOutput* kOutput = typedOutput(output->id());
         if (kOutput == nullptr) {
-            QMap<QOutputId, QOutput*>::const_iterator outputIt;
-
-            for (outputIt = mOutputs.constBegin(); outputIt != mOutputs.constEnd(); outputIt++) {
-                if (QString::compare(output->name(), outputIt.value()->name, Qt::CaseSensitive) == 0) {
-                    kOutput = dynamic_cast<KScreenOutput*>(outputIt.value());
+            for (KScreenOutput* o : typedOutputs()) {
+                if (QString::compare(output->name(), o->name, Qt::CaseSensitive) == 0) {
+                    kOutput = o;
                     break;
                 }
             }
 
             if (kOutput != nullptr) {
                 // Existing output changed id
-                mOutputs.remove(outputIt.key());
-                mOutputs.insert(output->id(), kOutput);
+                mLayout.remove(kOutput->id);
+                mOutputs.take(kOutput->id);
+                kOutput->id = output->id();
+                mOutputs.insert(kOutput);
+                kOutput->update(output);
             } else {
                 // New output
-                mOutputs.insert(output->id(), new KScreenOutput(this, output));
-                continue;
+                kOutput = new KScreenOutput(this, output);
+                mOutputs.insert(kOutput);
             }
+        } else {
+            // Update output
+            kOutput->update(output);
         }
-        // Update output
-        kOutput->update(output);
+        mLayout.set(kOutput->id, kOutput->mRect, kOutput->mPriority, kOutput->connection == QOutput::Connection::Connected, kOutput->mEnabled);
     }
 
     // Remove deleted outputs
-    for (QOutputId outputId: mOutputs.keys()) {
-        bool found = false;
-        for (KScreen::OutputPtr output : config->outputs()) {
-            if (output->id() == outputId) {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
-            deletedIds.append(outputId);
-    }
-
-    for (QOutputId outputId : deletedIds) {
-        QOutput* output = mOutputs.take(outputId);
-        delete output;
-    }
+    removeOutputsExcept(outputIds);
+    updateNameIndex();
 }
 
-bool KScreenResources::enableOutput(QOutput* output, bool grab)
+bool KScreenResources::apply(const QOutputChanges& changes, bool grab)
 {
     Q_UNUSED(grab);
 
-    // Cast output to internal type:
-    KScreenOutput* kOutput = dynamic_cast<KScreenOutput*>(output);
-    if (kOutput == nullptr)
+    // Update the output states:
+    QOutputChanges oldOutputStates;
+    if (!changeOutputStates(changes, &oldOutputStates))
         return false;
 
-    // The output is already enabled:
-    if (kOutput->mEnabled)
-        return true;
-
-    // Compute output offsets and priority shift:
-    bool oldOutputState = kOutput->mEnabled;
-    kOutput->mEnabled = true;
-    QRect totalScreen = computeTotalScreen();
-    QRect newScreen = computeScreen();
-    uint32_t totalMinPriority = computeTotalPriority();
-    uint32_t newMinPriority = computePriority();
-    Q_ASSERT(newMinPriority >= totalMinPriority);
-
-    // Update KScreen configuration:
-    bool ans = updateConfig(newScreen.topLeft() - totalScreen.topLeft(), newMinPriority - totalMinPriority);
-    if (!ans)
-        kOutput->mEnabled = oldOutputState;
+    // Update KScreen configuration (the live configuration is restored on failure):
+    KScreen::ConfigPtr savedConfig = mConfig->clone();
+    bool ans = updateConfig() && setConfig(mConfig);
+    if (!ans) {
+        changeOutputStates(oldOutputStates);
+        restoreConfig(savedConfig);
+    }
     return ans;
 }
 
-bool KScreenResources::disableOutput(QOutput* output, bool grab)
+void KScreenResources::applyAsync(const QOutputChanges& changes, bool grab, const QOperationCallback& callback)
 {
     Q_UNUSED(grab);
 
-    KScreenOutput* kOutput = dynamic_cast<KScreenOutput*>(output);
-    if (kOutput == nullptr)
-        return false;
-
-    // The output is already disabled:
-    if (!kOutput->mEnabled)
-        return true;
+    // Update the output states:
+    QOutputChanges oldOutputStates;
+    if (!changeOutputStates(changes, &oldOutputStates)) {
+        callback(false);
+        return;
+    }
 
-    // Compute output offsets and priority shift:
-    bool oldOutputState = kOutput->mEnabled;
-    kOutput->mEnabled = false;
-    QRect totalScreen = computeTotalScreen();
-    QRect newScreen = computeScreen();
-    if (newScreen.isNull()) {
-        kOutput->mEnabled = true;
-        return false;
+    // Update KScreen configuration (the live configuration is restored on failure):
+    KScreen::ConfigPtr savedConfig = mConfig->clone();
+    if (!updateConfig()) {
+        changeOutputStates(oldOutputStates);
+        callback(false);
+        return;
     }
-    uint32_t totalMinPriority = computeTotalPriority();
-    uint32_t newMinPriority = computePriority();
-    Q_ASSERT(newMinPriority >= totalMinPriority);
 
-    // Update KScreen configuration:
-    bool ans = updateConfig(newScreen.topLeft() - totalScreen.topLeft(), newMinPriority - totalMinPriority);
-    if (!ans)
-        kOutput->mEnabled = oldOutputState;
-    return ans;
+    // Set KScreen configuration:
+    QString operation = QStats::currentOperation();
+    QElapsedTimer timer;
+    timer.start();
+    qint64 traceBegin = QTracer::isEnabled() ? QTracer::now() : 0;
+    KScreen::SetConfigOperation* opSet = new KScreen::SetConfigOperation(mConfig);
+    QObject::connect(opSet, &KScreen::ConfigOperation::finished, &mContext, [this, oldOutputStates, savedConfig, callback, traceBegin, operation, timer] (KScreen::ConfigOperation* op) {
+        QStats::count(operation, "SetConfigOperation", timer.nsecsElapsed());
+        if (QTracer::isEnabled())
+            QTracer::record("setConfigOperation", traceBegin, QTracer::now());
+        if (op->hasError()) {
+            qWarning() << QObject::tr("Could not set config. Error:") << op->errorString();
+            changeOutputStates(oldOutputStates);
+            restoreConfig(savedConfig);
+            callback(false);
+        } else {
+            callback(true);
+        }
+    });
 }
 
-QRect KScreenResources::computeTotalScreen(void) const
+bool KScreenResources::changeOutputStates(const QOutputChanges& states, QOutputChanges* oldStates)
 {
-    QRect screen;
-    foreach (QOutput* o, mOutputs) {
-        KScreenOutput* kOutput = dynamic_cast<KScreenOutput*>(o);
-        if (kOutput == nullptr)
-            continue;
-        if (kOutput->connection != QOutput::Connection::Connected)
-            continue;
+    // All the outputs should exist:
+    for (auto it = states.constBegin(); it != states.constEnd(); it++) {
+        if (typedOutput(it.key()) == nullptr)
+            return false;
+    }
 
-        screen |= kOutput->mRect;
+    for (auto it = states.constBegin(); it != states.constEnd(); it++) {
+        KScreenOutput* kOutput = typedOutput(it.key());
+        if (oldStates != nullptr)
+            oldStates->insert(it.key(), kOutput->mEnabled);
+        kOutput->setEnabled(it.value());
     }
-    return screen;
+
+    return true;
 }
 
-QRect KScreenResources::computeScreen(void) const
+bool KScreenResources::updateConfig(void)
 {
-    QRect screen;
-    foreach (QOutput* o, mOutputs) {
-        KScreenOutput* kOutput = dynamic_cast<KScreenOutput*>(o);
-        if (kOutput == nullptr)
-            continue;
-        if (kOutput->connection != QOutput::Connection::Connected)
-            continue;
-        if (kOutput->mEnabled)
-            screen |= kOutput->mRect;
-    }
-    return screen;
+    // Compute output offsets and priority shift:
+    QRect totalScreen = mLayout.totalScreen();
+    QRect newScreen = mLayout.screen();
+    if (newScreen.isNull())
+        return false;
+    uint32_t totalMinPriority = mLayout.totalPriority();
+    uint32_t newMinPriority = mLayout.priority();
+    Q_ASSERT(newMinPriority >= totalMinPriority);
+
+    updateConfig(newScreen.topLeft() - totalScreen.topLeft(), newMinPriority - totalMinPriority);
+    return true;
 }
 
-uint32_t KScreenResources::computeTotalPriority(void) const
+void KScreenResources::updateConfig(const QPoint& offset, uint32_t shift)
 {
-    bool first = true;
-    uint32_t m = 0;
-    foreach (QOutput* o, mOutputs) {
-        KScreenOutput* kOutput = dynamic_cast<KScreenOutput*>(o);
+    foreach (KScreen::OutputPtr output, mConfig->outputs()) {
+        KScreenOutput* kOutput = typedOutput(output->id());
         if (kOutput == nullptr)
             continue;
-        if (kOutput->connection != QOutput::Connection::Connected)
-            continue;
-        if (first || (kOutput->mPriority < m))
-            m = kOutput->mPriority;
-        first = false;
+
+        if (output->isEnabled() != kOutput->mEnabled)
+            output->setEnabled(kOutput->mEnabled);
+        else
+            output->setPos(kOutput->mRect.topLeft() - offset);
+        if (output->isEnabled())
+            output->setPriority(kOutput->mPriority - shift);
     }
-    return m;
 }
 
-uint32_t KScreenResources::computePriority(void) const
+void KScreenResources::restoreConfig(const KScreen::ConfigPtr& savedConfig)
 {
-    bool first = true;
-    uint32_t m = 0;
-    foreach (QOutput* o, mOutputs) {
-        KScreenOutput* kOutput = dynamic_cast<KScreenOutput*>(o);
-        if (kOutput == nullptr)
-            continue;
-        if (kOutput->connection != QOutput::Connection::Connected)
-            continue;
-        if (!kOutput->mEnabled)
+    foreach (KScreen::OutputPtr output, mConfig->outputs()) {
+        KScreen::OutputPtr savedOutput = savedConfig->output(output->id());
+        if (savedOutput.isNull())
             continue;
-        if (first || (kOutput->mPriority < m))
-            m = kOutput->mPriority;
-        first = false;
+
+        output->setEnabled(savedOutput->isEnabled());
+        output->setPos(savedOutput->pos());
+        output->setPriority(savedOutput->priority());
     }
-    return m;
 }
 
-bool KScreenResources::updateConfig(const QPoint& offset, uint32_t shift)
+void KScreenResources::writeSnapshot(QDataStream& stream) const
 {
-    KScreen::ConfigPtr config = getConfig();
-    if (config.isNull())
-        return false;
-
-    foreach (KScreen::OutputPtr output, config->outputs())
-        qDebug() << output->isEnabled() << output-> isConnected() << output->name() << output->id() << output->pos() << output->priority();
-
-    refreshOutputs(config);
+    stream << (quint32) mConfig->outputs().size();
+    foreach (KScreen::OutputPtr output, mConfig->outputs())
+        stream << output->name() << output->pos() << (quint32) output->priority() << output->isEnabled();
+}
 
-    foreach (KScreen::OutputPtr output, config->outputs()) {
-        KScreenOutput* kOutput = dynamic_cast<KScreenOutput*>(mOutputs.value(output->id()));
-        if (kOutput == nullptr) {
+bool KScreenResources::readSnapshot(QDataStream& stream)
+{
+    // Read the output states:
+    QMap<QString, QPair<QPoint, quint32> > positions;
+    QMap<QString, bool> states;
+    quint32 outputCount = 0;
+    stream >> outputCount;
+    for (quint32 o = 0; (o < outputCount) && (stream.status() == QDataStream::Ok); o++) {
+        QString name;
+        QPoint pos;
+        quint32 priority;
+        bool enabled;
+        stream >> name >> pos >> priority >> enabled;
+        positions.insert(name, qMakePair(pos, priority));
+        states.insert(name, enabled);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << QObject::tr("Invalid snapshot");
+        return false;
+    }
 
+    // Update KScreen configuration:
+    foreach (KScreen::OutputPtr output, mConfig->outputs()) {
+        if (!states.contains(output->name()))
             continue;
-        }
-
-        if (output->isEnabled() != kOutput->mEnabled)
-            output->setEnabled(kOutput->mEnabled);
-        else
-            output->setPos(kOutput->mRect.topLeft() - offset);
+        output->setEnabled(states.value(output->name()));
+        output->setPos(positions.value(output->name()).first);
         if (output->isEnabled())
-            output->setPriority(kOutput->mPriority - shift);
+            output->setPriority(positions.value(output->name()).second);
     }
 
-    foreach (KScreen::OutputPtr output, config->outputs())
-        qDebug() << output->isEnabled() << output-> isConnected() << output->name() << output->id() << output->pos() << output->priority();
+    // Set KScreen configuration, or go back to the current one:
+    if (!setConfig(mConfig)) {
+        KScreen::ConfigPtr config = getConfig();
+        if (!config.isNull())
+            setLiveConfig(config);
+        return false;
+    }
 
-    return setConfig(config);
+    // Update the output states:
+    foreach (KScreen::OutputPtr output, mConfig->outputs()) {
+        KScreenOutput* kOutput = typedOutput(output->id());
+        if (kOutput != nullptr)
+            kOutput->setEnabled(output->isEnabled());
+    }
+    return true;
 }
@@ -19,16 +19,22 @@
 #ifndef KSCREENRESOURCES_H
 #define KSCREENRESOURCES_H
 
-#include "qscreenresources.h"
+#include "qtypedscreenresources.h"
 #include <KScreen/Config>
 
+class KScreenOutput;
+
 /*!
  * \brief Internal reprsentation for KScreen configuration
  *
  * This class holds the internal representation for a KScreen configuration.
  * It also allows to enable and disable the outputs.
+ *
+ * The KScreen configuration is retrieved once and kept up to date
+ * by KScreen::ConfigMonitor, so that the changes can be applied
+ * without retrieving the configuration again.
  */
-class KScreenResources : public QScreenResources
+class KScreenResources : public QTypedScreenResources<KScreenOutput>
 {
 public:
     static QString name;    /*!< Backend name */
@@ -42,6 +48,16 @@ public:
      * otherwise, \c nullptr.
      */
     static QScreenResources* create(bool forceBackend);
+    /*!
+     * \brief Asynchronous screen resources factory
+     *
+     * This method starts retrieving KScreen configuration
+     * and calls the given callback with a new screen resource instance
+     * when it is available, or with \c nullptr if KScreen is not usable.
+     * \param forceBackend Whether the backend name was specified.
+     * \param callback The callback to call when the probe is finished.
+     */
+    static void probe(bool forceBackend, const QProbeCallback& callback);
     /*!
      * \brief Retrieve KScreen current configuration
      *
@@ -55,35 +71,58 @@ public:
      *
      * Desallocates the internal data and releases the resources.
      */
-    inline virtual ~KScreenResources(void) {}
-
+    virtual ~KScreenResources(void);
+protected:
     /*!
-     * \brief Enable the given output
+     * \brief Refresh the cached output list
      *
-     * Enable the given output.
-     * \param output The output to enable.
+     * Refresh the QList of output internal representations.
+     */
+    void refreshOutputs(void);
+    /*!
+     * \brief Apply output changes
+     *
+     * Apply the given output changes with a single KScreen configuration update.
+     * \param changes The new enabled state of the outputs, by output identifier.
      * \param grab This parameter is ignored in this implementation.
-     * \return Whether this output was successfully enabled.
-     * \sa disableOutput()
+     * \return Whether the changes were successfully applied.
      */
-    bool enableOutput(QOutput* output, bool grab = false);
+    bool apply(const QOutputChanges& changes, bool grab);
     /*!
-     * \brief Disable the given output
+     * \brief Apply output changes asynchronously
      *
-     * Disable the given output.
-     * \param output The output to disable.
+     * Apply the given output changes with a single KScreen configuration update,
+     * without waiting for KScreen to answer.
+     * \param changes The new enabled state of the outputs, by output identifier.
      * \param grab This parameter is ignored in this implementation.
-     * \return Whether this output was successfully disabled.
-     * \sa enableOutput()
+     * \param callback The function called with the result of the operation.
      */
-    bool disableOutput(QOutput* output, bool grab = false);
-protected:
+    void applyAsync(const QOutputChanges& changes, bool grab, const QOperationCallback& callback);
     /*!
-     * \brief Refresh the cached output list
+     * \brief Refresh the cached output list asynchronously
      *
-     * Refresh the QList of output internal representations.
+     * Retrieve a new KScreen configuration, without waiting for KScreen to answer,
+     * and refresh the QList of output internal representations with it.
+     * \param callback The function called when the output list is refreshed.
      */
-    void refreshOutputs(void);
+    void refreshOutputsAsync(const std::function<void(void)>& callback);
+    /*!
+     * \brief Write a snapshot
+     *
+     * Write the position, priority and enabled state of each output to the given stream.
+     * \param stream The snapshot stream.
+     */
+    void writeSnapshot(QDataStream& stream) const;
+    /*!
+     * \brief Apply a snapshot
+     *
+     * Read the output positions, priorities and enabled states from the given stream
+     * and apply them with a single KScreen configuration update.
+     * The outputs are matched by name, since KScreen identifiers may change.
+     * \param stream The snapshot stream.
+     * \return Whether the snapshot was applied.
+     */
+    bool readSnapshot(QDataStream& stream);
 private:
     /*!
      * \brief Constructor
@@ -102,46 +141,48 @@ private:
      */
     void refreshOutputs(const KScreen::ConfigPtr& config);
     /*!
-     * \brief Compute total screen
+     * \brief Set the live configuration
      *
-     * Compute the screen rectangle when all outputs are on.
-     * \return The total screen rectangle
-     * \sa computeScreen()
+     * Replace the live KScreen configuration, refresh the outputs with it
+     * and register it with KScreen::ConfigMonitor.
+     * \param config The new live KScreen configuration.
      */
-    QRect computeTotalScreen(void) const;
+    void setLiveConfig(const KScreen::ConfigPtr& config);
     /*!
-     * \brief Compute screen
+     * \brief Change output states
      *
-     * Compute the screen rectangle when only enabled outputs are on.
-     * \return The screen rectangle
-     * \sa computeTotalScreen()
+     * Change the enabled state of the given outputs, without applying it.
+     * \param states The new enabled state of the outputs, by output identifier.
+     * \param oldStates If not \c nullptr, filled with the previous enabled state of the outputs.
+     * \return Whether all the outputs exist. If not, the output states are left unchanged.
      */
-    QRect computeScreen(void) const;
+    bool changeOutputStates(const QOutputChanges& states, QOutputChanges* oldStates = nullptr);
     /*!
-     * \brief Compute global minimum priority
-     *
-     * Compute the minimum priority taking into account all outputs.
-     * \return The global minimum priority
-     * \sa computePriority()
-     */
-    uint32_t computeTotalPriority(void) const;
-    /*!
-     * \brief Compute minimum priority
+     * \brief Update configuration
      *
-     * Compute the minimum priority taking into account only enabled outputs.
-     * \return The minimum priority
-     * \sa computeTotalPriority()
+     * This function computes the output offsets and priority shift
+     * and updates the live KScreen configuration with them.
+     * \return Whether the configuration was successfully updated.
+     * \sa updateConfig(const QPoint&, uint32_t)
      */
-    uint32_t computePriority(void) const;
+    bool updateConfig(void);
     /*!
      * \brief Update configuration
      *
-     * This function updates KScreen configuration.
+     * This function updates the live KScreen configuration.
      * \param offset The offset to shift the top-left corner of the enabled outputs by
      * \param shift The shift for the priorities of the enabled outputs
-     * \return Whether the configuration was successfully updated.
      */
-    bool updateConfig(const QPoint& offset, uint32_t shift);
+    void updateConfig(const QPoint& offset, uint32_t shift);
+    /*!
+     * \brief Restore configuration
+     *
+     * This function restores the enabled states, positions and priorities
+     * of the outputs of the live KScreen configuration, after it was rejected.
+     * \param savedConfig A copy of the live KScreen configuration before it was updated.
+     * \sa updateConfig()
+     */
+    void restoreConfig(const KScreen::ConfigPtr& savedConfig);
 
     /*!
      * \brief Get KScreen configuration
@@ -161,6 +202,10 @@ private:
      * \sa getConfig()
      */
     static bool setConfig(const KScreen::ConfigPtr& config);
+
+    KScreen::ConfigPtr mConfig;                     /*!< The live KScreen configuration */
+    QMetaObject::Connection mConfigConnection;      /*!< The connection to KScreen::ConfigMonitor */
+    QObject mContext;                               /*!< The context of the pending KScreen operations */
 };
 
 #endif // KSCREENRESOURCES_H
@@ -18,12 +18,28 @@
 
 #include "qscreenresources.h"
 #include "qoutput.h"
+#include "qstats.h"
+#include "qtracer.h"
+#ifdef SHUTDOWN_MONITOR_CONSOLE
+#   include "qmonitorclient.h"
+#   include "qmonitorserver.h"
+#endif // SHUTDOWN_MONITOR_CONSOLE
 
-#include <QMenu>
-#include <QSystemTrayIcon>
+#ifdef SHUTDOWN_MONITOR_X11
+#   include "xrrscreenresources.h"
+#endif // SHUTDOWN_MONITOR_X11
+#ifdef SHUTDOWN_MONITOR_SYSTRAY
+#   include "qtraymenu.h"
+#   include "qscreenresourcesworker.h"
+#   include <QSystemTrayIcon>
+#   include <QApplication>
+#   include <QSettings>
+#endif // SHUTDOWN_MONITOR_SYSTRAY
 #include <QTranslator>
-#include <QApplication>
+#include <QGuiApplication>
 #include <QCommandLineParser>
+#include <QScopedPointer>
+#include <QSocketNotifier>
 
 #include <QtDebug>
 
@@ -56,42 +72,125 @@
  * \section systray System tray interface
  * Right click on the system tray icon to make the context menu appear.
  * In the context menu, you can toogle a monitor by clicking on it.
+ * The menu stays open, so that several monitors can be toggled: the clicks are coalesced
+ * and applied in a single reconfiguration when the menu is closed, or after a quiet period
+ * (400 ms by default, which can be changed with the \c tray/quietPeriod key of
+ * \c ~/.config/pascom/ShutdownMonitor.conf).
+ * The reconfigurations are run in a dedicated backend thread, so that the menu stays responsive.
+ * With the X11 and Wlr backends, the menu follows the outputs which are connected or disconnected,
+ * and each output keeps its letter while it is connected.
  * A blue monitor \image{inline} html enabled-monitor.png "" is an enabled monitor, while
  * a black monitor \image{inline} html disabled-monitor.png "" is a disabled monitor.
  *
+ * \section blank Blanking
+ * With the X11 backends, an output can also be blanked from the "Blank" sub-menu
+ * of the system tray icon, or with the \c --blank-output switch.
+ * A blanked output is darkened by zeroing its gamma ramp: the layout is not changed,
+ * so that the windows are not moved, and it is blanked and unblanked with a single request.
+ *
+ * \section profiles Profiles
+ * Profiles are defined in the \c [profiles] group of \c ~/.config/pascom/ShutdownMonitor.conf.
+ * Each profile lists the names or glob patterns of the outputs it enables
+ * (comma-separated list), the other connected outputs are disabled.
+ * They can be applied from the "Profiles" sub-menu of the system tray icon,
+ * or with the \c --profile switch.
+ *
  * \section console Command-line interface
  * Hereafter is a table describing command-line options:
  * | Short | Long form          | Arguments      | Description                                                           |
  * | :---- | :----------------- | :------------- | :-------------------------------------------------------------------- |
  * | \c -t | \c --toggle-output | \c \<output\>  | The outputs to disable before starting (comma-separated list).        |
  * | ^     | ^                  | ^              | This switch can also be repeated to list multiple outputs.            |
+ * | ^     | ^                  | ^              | Glob patterns (e.g. \c HDMI-*) are accepted.                          |
+ * | \c -b | \c --blank-output  | \c \<output\>  | The outputs to blank before starting (comma-separated list).          |
+ * | ^     | ^                  | ^              | They are darkened without any modeset, so the layout is kept.         |
+ * | ^     | ^                  | ^              | This switch can also be repeated, glob patterns are accepted.         |
  * | \c -l | \c --list-outputs  |                | List outputs and quit.                                                |
+ * |       | \c --profile       | \c \<profile\> | Applies the given profile (in a single reconfiguration) and quit.     |
+ * |       | \c --daemon        |                | Keep running and serve the requests of other instances.               |
+ * | ^     | ^                  | ^              | When a daemon is running, \c -l, \c -t and \c -b are sent to it,      |
+ * | ^     | ^                  | ^              | unless \c --backend is given.                                         |
  * |       | \c --theme         | \c \<theme\>   | The theme to be used by the system tray interface.                    |
  * | ^     | ^                  | ^              | This option is available only when the systray interface is built in. |
- * |       | \c --list-backends |                | Lists the available backend (usable with the \c --backend switch).    |
+ * |       | \c --restore       |                | Restores the layout saved by an instance which was killed and quit.   |
+ * | ^     | ^                  | ^              | It is saved when outputs may be disabled (tray, \c -t, daemon).       |
+ * | ^     | ^                  | ^              | The outputs left blanked by the X11 backends are also restored.       |
+ * |       | \c --list-backends |                | Probes the backends and lists them with their availability.           |
  * |       | \c --backend       | \c \<backend\> | The backend to be used (if it cannot be used the program will stop).  |
  * | ^     | ^                  | ^              | By default, the first usable backend is selected.                     |
+ * |       | \c --trace         | \c \<file\>    | Records the duration of each phase in the given file,                 |
+ * | ^     | ^                  | ^              | in the trace event JSON format (for \c chrome://tracing or Perfetto). |
+ * |       | \c --stats         |                | Prints the requests sent for each operation at exit.                  |
+ * | ^     | ^                  | ^              | The daemon and the system tray also print them on \c SIGUSR1.         |
+ * | ^     | ^                  | ^              | With a running daemon, \c -l, \c -t and \c -b print the daemon ones   |
+ * | ^     | ^                  | ^              | (the daemon must have been started with \c --stats).                  |
  */
 #ifdef SHUTDOWN_MONITOR_CONSOLE
-QStringList toggleOutputs(QScreenResources* resources, QStringList& outputs)
+void toggleOutputs(QScreenResources* resources, const QStringList& outputs, const std::function<void(const QStringList&)>& callback)
 {
     QStringList toggledOutputs;
+    QStringList unknownOutputs;
 
-    foreach (QOutputId outputId, resources->outputs()) {
-        QOutput* output = resources->output(outputId);
-        if (output == nullptr)
-            continue;
-        if (output->connection != QOutput::Connection::Connected)
-            continue;
-        foreach (QString name, outputs) {
-            if (QString::compare(output->name, name, Qt::CaseSensitive) == 0) {
-                if (output->toggle())
-                    toggledOutputs << name;
-            }
-        }
+    // Resolve the names and patterns in a single pass:
+    QList<QOutput*> matchingOutputs = resources->resolveOutputs(outputs, &unknownOutputs);
+    foreach (QString name, unknownOutputs)
+        qWarning() << QObject::tr("Unknown output: %1").arg(name);
+
+    // Record all the changes in a single transaction:
+    resources->beginChanges();
+    foreach (QOutput* output, matchingOutputs) {
+        if (output->toggle())
+            toggledOutputs << output->name;
     }
 
-    return toggledOutputs;
+    // Apply them with only one reconfiguration:
+    resources->commitChangesAsync([toggledOutputs, callback] (bool ok) {
+        callback(ok ? toggledOutputs : QStringList());
+    });
+}
+
+void toggleOutputs(QMonitorClient* client, const QStringList& outputs, const std::function<void(const QStringList&)>& callback)
+{
+    QStringList toggledOutputs;
+    QStringList unknownOutputs;
+
+    // Let the daemon toggle the outputs:
+    bool ok = client->toggleOutputs(outputs, &toggledOutputs, &unknownOutputs);
+    foreach (QString name, unknownOutputs)
+        qWarning() << QObject::tr("Unknown output: %1").arg(name);
+
+    callback(ok ? toggledOutputs : QStringList());
+}
+
+QStringList blankOutputs(QScreenResources* resources, const QStringList& outputs, bool blanked)
+{
+    QStringList blankedOutputs;
+    QStringList unknownOutputs;
+
+    // Resolve the names and patterns in a single pass:
+    QList<QOutput*> matchingOutputs = resources->resolveOutputs(outputs, &unknownOutputs);
+    foreach (QString name, unknownOutputs)
+        qWarning() << QObject::tr("Unknown output: %1").arg(name);
+
+    // Blanking does not change the layout, so that each output is blanked immediately:
+    foreach (QOutput* output, matchingOutputs) {
+        if (resources->blankOutput(output, blanked))
+            blankedOutputs << output->name;
+    }
+    return blankedOutputs;
+}
+
+QStringList blankOutputs(QMonitorClient* client, const QStringList& outputs, bool blanked)
+{
+    QStringList blankedOutputs;
+    QStringList unknownOutputs;
+
+    // Let the daemon blank the outputs:
+    bool ok = client->blankOutputs(outputs, blanked, &blankedOutputs, &unknownOutputs);
+    foreach (QString name, unknownOutputs)
+        qWarning() << QObject::tr("Unknown output: %1").arg(name);
+
+    return ok ? blankedOutputs : QStringList();
 }
 
 static int socketFds[2];
@@ -102,57 +201,225 @@ void signalHandler(int signum) {
 }
 #endif // SHUTDOWN_MONITOR_CONSOLE
 
-int main(int argc, char *argv[])
+void printStats(void)
 {
-    // Setup application:
-    QApplication app(argc, argv);
-    QApplication::setApplicationName("ShutdownMonitor");
-    QApplication::setApplicationVersion("3.0.0");
-    QApplication::setOrganizationName("pascom");
+    QStringList lines = QStats::report();
+    if (lines.isEmpty())
+        return;
 
-    // Load and install translator for the system locale:
-    QTranslator translator(&app);
-    if (translator.load(QLocale(), "shutdownmonitor", "_", app.applicationDirPath())) {
-        if (!app.installTranslator(&translator))
-            qWarning() << "Could not install translator";
-    } else {
-        qWarning() << "Could not load translator";
-    }
+    std::cout << qPrintable(QObject::tr("Statistics:")) << std::endl;
+    foreach (QString line, lines)
+        std::cout << "  " << qPrintable(line) << std::endl;
+}
 
-    // Setup command line arguments parser:
-    QCommandLineParser parser;
-    parser.addVersionOption();
-    parser.addHelpOption();
-    parser.setApplicationDescription(QObject::tr("Enable and disable the monitors from the system tray or the command line."));
+static int statsFds[2];
+void statsSignalHandler(int signum) {
+    Q_UNUSED(signum);
+    char a = 's';
+    write(statsFds[0], &a, 1);
+}
+
+void addOptions(QCommandLineParser& parser)
+{
     parser.addOption(QCommandLineOption("list-backends", QObject::tr("List backends and quit.")));
     parser.addOption(QCommandLineOption("backend", QObject::tr("The backend to be used to manage the screen."), QObject::tr("backend"), QString()));
+    parser.addOption(QCommandLineOption("trace", QObject::tr("Record the duration of each phase in the given file (trace event JSON format)."), QObject::tr("file")));
+    parser.addOption(QCommandLineOption("restore", QObject::tr("Restore the layout saved by an instance which did not exit cleanly and quit.")));
+    parser.addOption(QCommandLineOption("stats", QObject::tr("Print the requests sent for each operation at exit (and when SIGUSR1 is received).")));
 #ifdef SHUTDOWN_MONITOR_SYSTRAY
     parser.addOption(QCommandLineOption("theme", QObject::tr("The theme to use for the icons. It can be 'light' or 'dark'."), QObject::tr("theme"), "light"));
 #endif // SHUTDOWN_MONITOR_SYSTRAY
 #ifdef SHUTDOWN_MONITOR_CONSOLE
     parser.addOption(QCommandLineOption({"t", "toggle-output"},
                      QObject::tr("The outputs to disable before starting (comma-separated list).\n"
+                                 "This switch can also be repeated to list multiple outputs.\n"
+                                 "Glob patterns (e.g. HDMI-*) are accepted."),
+                     QObject::tr("output")));
+    parser.addOption(QCommandLineOption({"b", "blank-output"},
+                     QObject::tr("The outputs to blank before starting (comma-separated list).\n"
+                                 "They are darkened without changing the layout.\n"
                                  "This switch can also be repeated to list multiple outputs."),
                      QObject::tr("output")));
     parser.addOption(QCommandLineOption({"l", "list-outputs"}, QObject::tr("List outputs and quit.")));
+    parser.addOption(QCommandLineOption("profile", QObject::tr("Apply the given profile and quit."), QObject::tr("profile")));
+    parser.addOption(QCommandLineOption("daemon", QObject::tr("Keep running and serve the command-line requests of other instances.")));
+#endif // SHUTDOWN_MONITOR_CONSOLE
+}
+
+bool consoleRun(const QCommandLineParser& parser)
+{
+    // The system tray interface is started when no console action is requested:
+    if (parser.isSet("list-backends") || parser.isSet("restore"))
+        return true;
+#ifdef SHUTDOWN_MONITOR_CONSOLE
+    return parser.isSet("daemon") || parser.isSet("list-outputs") || parser.isSet("toggle-output")
+        || parser.isSet("blank-output") || parser.isSet("profile");
+#else // SHUTDOWN_MONITOR_CONSOLE
+    return false;
 #endif // SHUTDOWN_MONITOR_CONSOLE
-    parser.process(app);
+}
+
+QCoreApplication* createApplication(int& argc, char *argv[])
+{
+    // Help and version do not need any GUI:
+    for (int a = 1; a < argc; a++) {
+        QString arg = QString::fromLocal8Bit(argv[a]);
+        if ((arg == "-h") || (arg == "--help") || (arg == "-?") || (arg == "--help-all") || (arg == "-v") || (arg == "--version"))
+            return new QCoreApplication(argc, argv);
+    }
+
+#ifdef SHUTDOWN_MONITOR_SYSTRAY
+    // The backends only need a GUI application, widgets are only needed by the system tray.
+    // The options are parsed as main() will, so that both agree on the mode.
+    // Errors are ignored here: the Qt options are not removed from the arguments yet,
+    // and invalid options are reported by main():
+    QStringList arguments;
+    for (int a = 0; a < argc; a++)
+        arguments << QString::fromLocal8Bit(argv[a]);
+    QCommandLineParser parser;
+    parser.addVersionOption();
+    parser.addHelpOption();
+    addOptions(parser);
+    parser.parse(arguments);
+    if (consoleRun(parser))
+        return new QGuiApplication(argc, argv);
+    return new QApplication(argc, argv);
+#else // SHUTDOWN_MONITOR_SYSTRAY
+    return new QGuiApplication(argc, argv);
+#endif // SHUTDOWN_MONITOR_SYSTRAY
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef SHUTDOWN_MONITOR_X11
+    // Xlib thread support must be initialized before Qt opens its X connection:
+    XRandRScreenResources::initThreads();
+#endif // SHUTDOWN_MONITOR_X11
+
+    // Setup application (widgets are only loaded when the system tray interface is started):
+    QScopedPointer<QCoreApplication> app(createApplication(argc, argv));
+    QCoreApplication::setApplicationName("ShutdownMonitor");
+    QCoreApplication::setApplicationVersion("3.0.0");
+    QCoreApplication::setOrganizationName("pascom");
+
+    // Start tracing as soon as possible (the trace is saved when the application is destroyed):
+    QStringList arguments = app->arguments();
+    for (int a = 1; a < arguments.size(); a++) {
+        QString traceFileName;
+        if (arguments.at(a).startsWith("--trace="))
+            traceFileName = arguments.at(a).mid(8);
+        else if ((arguments.at(a) == "--trace") && (a + 1 < arguments.size()))
+            traceFileName = arguments.at(a + 1);
+        if (!traceFileName.isEmpty()) {
+            QTracer::start(traceFileName);
+            qAddPostRoutine(QTracer::stop);
+            break;
+        }
+    }
+
+    // Load and install translator for the system locale:
+    QTranslator translator(app.data());
+    {
+        QTraceScope trace("loadTranslator");
+        if (translator.load(QLocale(), "shutdownmonitor", "_", app->applicationDirPath())) {
+            if (!app->installTranslator(&translator))
+                qWarning() << "Could not install translator";
+        } else {
+            qWarning() << "Could not load translator";
+        }
+    }
+
+    // Setup command line arguments parser:
+    QCommandLineParser parser;
+    parser.addVersionOption();
+    parser.addHelpOption();
+    parser.setApplicationDescription(QObject::tr("Enable and disable the monitors from the system tray or the command line."));
+    addOptions(parser);
+    parser.process(*app);
 
     // List backends:
     if (parser.isSet("list-backends")) {
         std::cout << qPrintable(QObject::tr("Available backends:")) << std::endl;
-        foreach (QString backend, QScreenResources::listBackends())
-            std::cout << "  - " << qPrintable(backend) << std::endl;
+        foreach (QScreenResources::BackendProbe probe, QScreenResources::probeBackends()) {
+            std::cout << "  - " << qPrintable(probe.name) << ": ";
+            if (probe.available)
+                std::cout << qPrintable(QObject::tr("available (%1 ms)").arg(probe.time)) << std::endl;
+            else if (probe.time >= 0)
+                std::cout << qPrintable(QObject::tr("unavailable (%1 ms)").arg(probe.time)) << std::endl;
+            else
+                std::cout << qPrintable(QObject::tr("timed out")) << std::endl;
+        }
         return 0;
     }
 
+#ifdef SHUTDOWN_MONITOR_CONSOLE
+    // Use the daemon when it is running, so that no screen resources are needed:
+    QMonitorClient client;
+    bool useDaemon = !parser.isSet("daemon") && !parser.isSet("backend") && !parser.isSet("restore")
+                  && (parser.isSet("list-outputs") || parser.isSet("toggle-output") || parser.isSet("blank-output") || parser.isSet("profile"))
+                  && client.connectToDaemon();
+#else // SHUTDOWN_MONITOR_CONSOLE
+    bool useDaemon = false;
+#endif // SHUTDOWN_MONITOR_CONSOLE
+
+#ifdef SHUTDOWN_MONITOR_SYSTRAY
+    // The system tray interface loads the screen resources in a worker thread:
+    bool systrayRun = !consoleRun(parser);
+#else // SHUTDOWN_MONITOR_SYSTRAY
+    bool systrayRun = false;
+#endif // SHUTDOWN_MONITOR_SYSTRAY
+
     // Load screen resources:
-    QScreenResources* resources = QScreenResources::create(parser.value("backend"));
-    if (resources == nullptr) {
-        qWarning() << QObject::tr("No supported backend available");
-        return -1;
+    QScreenResources* resources = nullptr;
+#ifdef SHUTDOWN_MONITOR_CONSOLE
+    if (useDaemon)
+        std::cout << qPrintable(QObject::tr("Using daemon: ")) << qPrintable(QMonitorServer::socketPath()) << std::endl;
+#endif // SHUTDOWN_MONITOR_CONSOLE
+    if (!useDaemon && !systrayRun) {
+        resources = QScreenResources::create(parser.value("backend"));
+        if (resources == nullptr) {
+            qWarning() << QObject::tr("No supported backend available");
+            return -1;
+        }
+        std::cout << qPrintable(QObject::tr("Using backend: ")) << qPrintable(resources->name) << std::endl;
+    }
+
+    // Print the statistics at exit, and when SIGUSR1 is received:
+    QScopedPointer<QSocketNotifier> statsNotifier;
+    if (parser.isSet("stats") && !useDaemon) {
+        QStats::setEnabled(true);
+        qAddPostRoutine(printStats);
+
+        if (socketpair(AF_UNIX, SOCK_RAW, 0, statsFds) != 0) {
+            qWarning() << QObject::tr("Could not create socket pair. Error:") << errno << QString("(%1)").arg(strerror(errno));
+        } else {
+            struct sigaction sigUsr1;
+            sigUsr1.sa_handler = statsSignalHandler;
+            sigemptyset(&sigUsr1.sa_mask);
+            sigUsr1.sa_flags = SA_RESTART;
+
+            if (sigaction(SIGUSR1, &sigUsr1, 0) != 0) {
+                qWarning() << QObject::tr("Could not install signal handler. Error:") << errno << QString("(%1)").arg(strerror(errno));
+            } else {
+                statsNotifier.reset(new QSocketNotifier(statsFds[1], QSocketNotifier::Read));
+                QObject::connect(statsNotifier.data(), &QSocketNotifier::activated, [] {
+                    char buffer;
+                    read(statsFds[1], &buffer, 1);
+                    printStats();
+                });
+            }
+        }
+    }
+
+    // Restore the layout saved by an instance which did not exit cleanly:
+    if (parser.isSet("restore")) {
+        bool ok = (resources != nullptr) && resources->restoreSnapshot();
+        if (ok)
+            std::cout << qPrintable(QObject::tr("Layout restored")) << std::endl;
+        qDebug() << "Delete screen resources";
+        delete resources;
+        return ok ? 0 : -5;
     }
-    std::cout << qPrintable(QObject::tr("Using backend: ")) << qPrintable(resources->name) << std::endl;
 
 #ifdef SHUTDOWN_MONITOR_SYSTRAY
     bool done = false;
@@ -161,25 +428,70 @@ int main(int argc, char *argv[])
 #endif // SHUTDOWN_MONITOR_SYSTRAY
 
 #ifdef SHUTDOWN_MONITOR_CONSOLE
+    // Run as a daemon:
+    if (parser.isSet("daemon")) {
+        int ret = -4;
+        QMonitorServer server(resources);
+        if ((resources != nullptr) && server.listen()) {
+            std::cout << qPrintable(QObject::tr("Listening on: ")) << qPrintable(QMonitorServer::socketPath()) << std::endl;
+            bool saved = resources->saveSnapshot();
+            ret = app->exec();
+            // The layout chosen through the daemon is kept:
+            if (saved)
+                QScreenResources::discardSnapshot();
+        }
+        qDebug() << "Delete screen resources";
+        delete resources;
+        return ret;
+    }
+
     // List outputs:
     if (parser.isSet("list-outputs")) {
+        QStringList names;
+        if (useDaemon) {
+            client.listOutputs(&names);
+        } else if (resources != nullptr) {
+            for (QOutput* output : resources->outputs()) {
+                if (output->connection == QOutput::Connection::Connected)
+                    names << output->name;
+            }
+        }
+
         std::cout << qPrintable(QObject::tr("Connected outputs:")) << std::endl;
-        foreach (QOutputId outputId, resources->outputs()) {
-            QOutput* output = resources->output(outputId);
-            if (output == nullptr)
-                continue;
-            if (output->connection != QOutput::Connection::Connected)
-                continue;
-            std::cout << "  - " << qPrintable(output->name) << std::endl;
+        foreach (QString name, names)
+            std::cout << "  - " << qPrintable(name) << std::endl;
+        done = true;
+    }
+
+    // Apply profile:
+    if (parser.isSet("profile")) {
+        bool ok = false;
+        if (useDaemon) {
+            ok = client.applyProfile(parser.value("profile"));
+        } else if (resources != nullptr) {
+            // Wait for the result in the application event loop (the callback may also be called immediately):
+            bool finished = false;
+            resources->applyProfileAsync(parser.value("profile"), [&ok, &finished] (bool result) {
+                ok = result;
+                finished = true;
+                QCoreApplication::quit();
+            });
+            if (!finished)
+                app->exec();
         }
+        if (ok)
+            std::cout << qPrintable(QObject::tr("Applied profile: %1").arg(parser.value("profile"))) << std::endl;
         done = true;
     }
 
-    // Toggle output:
+    // Toggle and blank outputs:
     QStringList outputs;
     foreach (QString outputList, parser.values("toggle-output"))
         outputs << outputList.split(',', Qt::SkipEmptyParts);
-    if (!outputs.isEmpty()) {
+    QStringList outputsToBlank;
+    foreach (QString outputList, parser.values("blank-output"))
+        outputsToBlank << outputList.split(',', Qt::SkipEmptyParts);
+    if (!outputs.isEmpty() || !outputsToBlank.isEmpty()) {
         if (socketpair(AF_UNIX, SOCK_RAW, 0, socketFds) != 0) {
             qWarning() << QObject::tr("Could not create socket pair. Error:") << errno << QString("(%1)").arg(strerror(errno));
         } else {
@@ -191,20 +503,67 @@ int main(int argc, char *argv[])
             if (sigaction(SIGINT, &sigInt, 0) != 0) {
                 qWarning() << QObject::tr("Could not install signal handler. Error:") << errno << QString("(%1)").arg(strerror(errno));
             } else {
-                char buffer;
                 QStringList toggledOutputs;
+                QStringList blankedOutputs;
+                bool saved = false;
+                QSocketNotifier signalNotifier(socketFds[1], QSocketNotifier::Read);
+                auto toggle = [resources, &client] (const QStringList& outputs, const std::function<void(const QStringList&)>& callback) {
+                    if (outputs.isEmpty())
+                        callback(QStringList());
+                    else if (resources != nullptr)
+                        toggleOutputs(resources, outputs, callback);
+                    else
+                        toggleOutputs(&client, outputs, callback);
+                };
+                auto blank = [resources, &client] (const QStringList& outputs, bool blanked) {
+                    if (outputs.isEmpty())
+                        return QStringList();
+                    if (resources != nullptr)
+                        return blankOutputs(resources, outputs, blanked);
+                    return blankOutputs(&client, outputs, blanked);
+                };
 
-                std::cout << qPrintable(QObject::tr("Press Ctrl+C to restore previous state. "));
-                std::cout.flush();
-                toggledOutputs = toggleOutputs(resources, outputs);
-                read(socketFds[1], &buffer, 1);
-                std::cout << std::endl;
-                toggleOutputs(resources, toggledOutputs);
+                // Restore previous state when Ctrl+C is pressed:
+                signalNotifier.setEnabled(false);
+                QObject::connect(&signalNotifier, &QSocketNotifier::activated, [toggle, blank, &signalNotifier, &toggledOutputs, &blankedOutputs, &saved] {
+                    char buffer;
+                    read(socketFds[1], &buffer, 1);
+                    signalNotifier.setEnabled(false);
+                    std::cout << std::endl;
+                    QStatsOperation stats("restore");
+                    bool unblanked = (blank(blankedOutputs, false).size() == blankedOutputs.size());
+                    toggle(toggledOutputs, [&toggledOutputs, &saved, unblanked] (const QStringList& restoredOutputs) {
+                        if (saved && unblanked && (restoredOutputs.size() == toggledOutputs.size()))
+                            QScreenResources::discardSnapshot();
+                        QCoreApplication::quit();
+                    });
+                });
+
+                // Blank and toggle outputs and wait for Ctrl+C (the layout can be restored with --restore if this process is killed):
+                saved = (resources != nullptr) && resources->saveSnapshot();
+                blankedOutputs = blank(outputsToBlank, true);
+                toggle(outputs, [&signalNotifier, &toggledOutputs] (const QStringList& outputs) {
+                    toggledOutputs = outputs;
+                    std::cout << qPrintable(QObject::tr("Press Ctrl+C to restore previous state. "));
+                    std::cout.flush();
+                    signalNotifier.setEnabled(true);
+                });
+                app->exec();
             }
         }
         done = true;
     }
 
+    // Print the statistics of the daemon:
+    if (useDaemon && parser.isSet("stats")) {
+        QStringList lines;
+        if (client.stats(&lines)) {
+            std::cout << qPrintable(QObject::tr("Daemon statistics:")) << std::endl;
+            foreach (QString line, lines)
+                std::cout << "  " << qPrintable(line) << std::endl;
+        }
+    }
+
     if (done) {
         qDebug() << "Delete screen resources";
         delete resources;
@@ -213,6 +572,13 @@ int main(int argc, char *argv[])
 #endif // SHUTDOWN_MONITOR_CONSOLE
 
 #ifdef SHUTDOWN_MONITOR_SYSTRAY
+    // The system tray interface needs widgets:
+    if (qobject_cast<QApplication*>(app.data()) == nullptr) {
+        qWarning() << QObject::tr("The system tray interface cannot be started from a command-line run");
+        delete resources;
+        return -2;
+    }
+
     // Check that system tray is available:
     if (!QSystemTrayIcon::isSystemTrayAvailable()) {
         qWarning() << QObject::tr("This program requires the system tray");
@@ -228,76 +594,90 @@ int main(int argc, char *argv[])
         parser.showHelp(-3);
     }
 
-    // Create the system tray menu:
-    int o = 0;
-    QMenu menu;
-    QIcon  enabledMonitorIcon(QString(":/icons/%1/enabled-monitor.png").arg(parser.value("theme")));
-    QIcon disabledMonitorIcon(QString(":/icons/%1/disabled-monitor.png").arg(parser.value("theme")));
-    foreach (QOutputId outputId, resources->outputs()) {
-        QOutput* output = resources->output(outputId);
-        if (output == nullptr)
-            continue;
-        if (output->connection != QOutput::Connection::Connected)
-            continue;
-        qDebug() << output->display();
-
-        // Create an action for this connected output:
-        QAction* action;
-        if (o < ('Q' - 'A')) {
-            action = menu.addAction(QString("%1. %2").arg(QChar(o++ + 'A'))
-                                                     .arg(output->display()));
-        } else {
-            action = menu.addAction(QString("     %1").arg(output->display()));
-        }
+    // Load the screen resources in the backend thread, so that the backend latency does not block the menu:
+    QScreenResourcesWorker worker;
+    if (!worker.start(parser.value("backend"))) {
+        qWarning() << QObject::tr("No supported backend available");
+        return -1;
+    }
+    std::cout << qPrintable(QObject::tr("Using backend: ")) << qPrintable(worker.backendName()) << std::endl;
 
-        action->setIcon(output->enabled() ? enabledMonitorIcon : disabledMonitorIcon);
-        action->setData(QVariant::fromValue<QOutputId>(outputId));
-        QObject::connect(action, &QAction::triggered, [resources, action, &enabledMonitorIcon, &disabledMonitorIcon] {
-            QOutput* output = resources->output(action->data().value<QOutputId>());
-            output->toggle();
-            action->setIcon(output->enabled() ? enabledMonitorIcon : disabledMonitorIcon);
-        });
+    // Save the layout, so that it can be restored with --restore if this process is killed:
+    bool saved = worker.runAndWait([] (QScreenResources* resources) {
+        return resources->saveSnapshot();
+    });
+
+    // Create the system tray menu (the output actions follow the connected outputs, the clicks are coalesced):
+    qint64 menuBegin = QTracer::isEnabled() ? QTracer::now() : 0;
+    QTrayMenu menu(&worker);
+    menu.setIcons(QIcon(QString(":/icons/%1/enabled-monitor.png").arg(parser.value("theme"))),
+                  QIcon(QString(":/icons/%1/disabled-monitor.png").arg(parser.value("theme"))));
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    menu.setQuietPeriod(settings.value("tray/quietPeriod", menu.quietPeriod()).toInt());
+
+    // Create the profile sub-menu:
+    QStringList profiles = QScreenResources::profiles();
+    if (!profiles.isEmpty()) {
+        QMenu *profileMenu = menu.addMenu(QIcon::fromTheme("video-display"), QObject::tr("Profiles"));
+        foreach (QString profile, profiles) {
+            QAction* profileAction = profileMenu->addAction(profile);
+            QObject::connect(profileAction, &QAction::triggered, [&worker, &menu, profile] {
+                worker.run([profile] (QScreenResources* resources) {
+                    return resources->applyProfile(profile);
+                }, [&menu] (bool ok) {
+                    Q_UNUSED(ok);
+                    menu.updateIcons();
+                });
+            });
+        }
     }
-    menu.addSeparator();
+
+    // Create the blank sub-menu (blanking darkens an output without changing the layout):
+    if (worker.canBlank())
+        menu.addBlankMenu(QIcon::fromTheme("display-brightness"), QObject::tr("Blank"));
 
     // Create the theme sub-menu:
     QMenu *themeMenu = menu.addMenu(QIcon::fromTheme("palette-symbolic"), QObject::tr("Theme"));
     foreach (QString theme, availableThemes) {
         QAction* themeAction = themeMenu->addAction(QObject::tr(theme.toLocal8Bit().data()));
         themeAction->setData(theme);
-        QObject::connect(themeAction, &QAction::triggered, [resources, &menu, themeAction, &enabledMonitorIcon, &disabledMonitorIcon] {
-            enabledMonitorIcon  = QIcon(QString(":/icons/%1/enabled-monitor.png").arg(themeAction->data().toString()));
-            disabledMonitorIcon = QIcon(QString(":/icons/%1/disabled-monitor.png").arg(themeAction->data().toString()));
-
-            foreach (QAction* action, menu.actions()) {
-                if (action->data().isNull())
-                    continue;
-                QOutput* output = resources->output(action->data().value<QOutputId>());
-                action->setIcon(output->enabled() ? enabledMonitorIcon : disabledMonitorIcon);
-            }
+        QObject::connect(themeAction, &QAction::triggered, [&menu, themeAction] {
+            menu.setIcons(QIcon(QString(":/icons/%1/enabled-monitor.png").arg(themeAction->data().toString())),
+                          QIcon(QString(":/icons/%1/disabled-monitor.png").arg(themeAction->data().toString())));
         });
     }
 
     // Add the exit action:
-    menu.addAction(QIcon::fromTheme("window-close"), QObject::tr("Quit"), &app, &QApplication::quit);
+    menu.addAction(QIcon::fromTheme("window-close"), QObject::tr("Quit"), app.data(), &QCoreApplication::quit);
+    if (QTracer::isEnabled())
+        QTracer::record("createMenu", menuBegin, QTracer::now());
 
     // Show the system tray icon:
-    QSystemTrayIcon icon(QIcon::fromTheme("monitor"), &app);
+    QSystemTrayIcon icon(QIcon::fromTheme("monitor"), app.data());
     icon.setContextMenu(&menu);
     icon.show();
 
-    // Ensure that the screen resources are deallocated before quitting the application:
-    QObject::connect(&app, &QApplication::aboutToQuit, [resources] {
-        foreach (QOutputId outputId, resources->outputs()) {
-            QOutput* output = resources->output(outputId);
-            if (output->connection == QOutput::Connection::Connected)
-                output->enable();
-        }
-        qDebug() << "Delete screen resources";
-        delete resources;
+    // Restore the outputs before quitting the application (the screen resources are deleted with the worker).
+    // This is synchronous, as the event loop has stopped; the KScreen operations run in the backend thread:
+    QObject::connect(app.data(), &QCoreApplication::aboutToQuit, [&worker, saved] {
+        bool restored = worker.runAndWait([] (QScreenResources* resources) {
+            QStatsOperation stats("restore");
+            for (QOutput* output : resources->outputs()) {
+                if (output->blanked())
+                    output->unblank();
+            }
+            resources->beginChanges();
+            for (QOutput* output : resources->outputs()) {
+                if (output->connection == QOutput::Connection::Connected)
+                    output->enable();
+            }
+            return resources->commitChanges();
+        });
+        if (restored && saved)
+            QScreenResources::discardSnapshot();
     });
 
     // Start application event loop:
-    return app.exec();
+    return app->exec();
 #endif // SHUTDOWN_MONITOR_SYSTRAY
 }
@@ -0,0 +1,131 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "qmonitorclient.h"
+#include "qmonitorserver.h"
+
+#include <QFileInfo>
+
+#include <QtDebug>
+
+#include <unistd.h>
+
+bool QMonitorClient::connectToDaemon(int timeout)
+{
+    // Do not talk to a socket created by another user (e.g. in the temporary directory):
+    QFileInfo socketInfo(QMonitorServer::socketPath());
+    if (socketInfo.exists() && (socketInfo.ownerId() != getuid())) {
+        qWarning() << QObject::tr("The daemon socket %1 belongs to another user").arg(socketInfo.filePath());
+        return false;
+    }
+
+    mSocket.connectToServer(QMonitorServer::socketPath());
+    return mSocket.waitForConnected(timeout);
+}
+
+bool QMonitorClient::listOutputs(QStringList* outputs)
+{
+    QStringList lines;
+    if (!request("LIST", &lines, nullptr))
+        return false;
+
+    foreach (QString line, lines) {
+        if (line.startsWith("OUTPUT "))
+            outputs->append(line.section(' ', 1, 1));
+    }
+    return true;
+}
+
+bool QMonitorClient::toggleOutputs(const QStringList& outputs, QStringList* toggledOutputs, QStringList* unknownOutputs)
+{
+    QStringList lines;
+    QString result;
+    if (!request(QString("TOGGLE %1").arg(outputs.join(',')), &lines, &result))
+        return false;
+
+    foreach (QString line, lines) {
+        if (line.startsWith("UNKNOWN "))
+            unknownOutputs->append(line.section(' ', 1));
+    }
+    *toggledOutputs = result.split(',', Qt::SkipEmptyParts);
+    return true;
+}
+
+bool QMonitorClient::blankOutputs(const QStringList& outputs, bool blanked, QStringList* blankedOutputs, QStringList* unknownOutputs)
+{
+    QStringList lines;
+    QString result;
+    if (!request(QString("%1 %2").arg(blanked ? "BLANK" : "UNBLANK").arg(outputs.join(',')), &lines, &result))
+        return false;
+
+    foreach (QString line, lines) {
+        if (line.startsWith("UNKNOWN "))
+            unknownOutputs->append(line.section(' ', 1));
+    }
+    *blankedOutputs = result.split(',', Qt::SkipEmptyParts);
+    return true;
+}
+
+bool QMonitorClient::applyProfile(const QString& name)
+{
+    QStringList lines;
+    return request(QString("PROFILE %1").arg(name), &lines, nullptr);
+}
+
+bool QMonitorClient::stats(QStringList* lines)
+{
+    QStringList replyLines;
+    if (!request("STATS", &replyLines, nullptr))
+        return false;
+
+    foreach (QString line, replyLines) {
+        if (line.startsWith("STAT "))
+            lines->append(line.mid(5));
+    }
+    return true;
+}
+
+bool QMonitorClient::request(const QString& request, QStringList* lines, QString* result)
+{
+    mSocket.write(request.toUtf8() + '\n');
+    if (!mSocket.waitForBytesWritten()) {
+        qWarning() << QObject::tr("Could not send request to daemon. Error:") << mSocket.errorString();
+        return false;
+    }
+
+    forever {
+        while (!mSocket.canReadLine()) {
+            if (!mSocket.waitForReadyRead()) {
+                qWarning() << QObject::tr("Could not receive reply from daemon. Error:") << mSocket.errorString();
+                return false;
+            }
+        }
+
+        QString line = QString::fromUtf8(mSocket.readLine()).trimmed();
+        if (line.startsWith("ERR")) {
+            qWarning() << QObject::tr("Daemon error:") << line.section(' ', 1);
+            return false;
+        }
+        if ((line == "OK") || line.startsWith("OK ")) {
+            if (result != nullptr)
+                *result = line.section(' ', 1);
+            return true;
+        }
+        lines->append(line);
+    }
+}
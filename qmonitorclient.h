@@ -0,0 +1,103 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef QMONITORCLIENT_H
+#define QMONITORCLIENT_H
+
+#include <QLocalSocket>
+#include <QStringList>
+
+/*!
+ * \brief Daemon control client
+ *
+ * This class sends requests to a daemon (see QMonitorServer),
+ * so that the command-line interface does not need to create screen resources.
+ */
+class QMonitorClient
+{
+public:
+    /*!
+     * \brief Connect to the daemon
+     *
+     * Try to connect to the daemon of the current user.
+     * \param timeout The connection timeout (in ms).
+     * \return Whether the client is connected to the daemon.
+     */
+    bool connectToDaemon(int timeout = 100);
+
+    /*!
+     * \brief List the connected outputs
+     *
+     * Ask the daemon for the list of the connected outputs.
+     * \param outputs Filled with the names of the connected outputs.
+     * \return Whether the request succeeded.
+     */
+    bool listOutputs(QStringList* outputs);
+    /*!
+     * \brief Toggle outputs
+     *
+     * Ask the daemon to toggle the given outputs in a single reconfiguration.
+     * \param outputs The names or glob patterns of the outputs to toggle.
+     * \param toggledOutputs Filled with the names of the toggled outputs.
+     * \param unknownOutputs Filled with the names which do not match any output.
+     * \return Whether the request succeeded.
+     */
+    bool toggleOutputs(const QStringList& outputs, QStringList* toggledOutputs, QStringList* unknownOutputs);
+    /*!
+     * \brief Blank outputs
+     *
+     * Ask the daemon to blank or unblank the given outputs, without changing the layout.
+     * \param outputs The names or glob patterns of the outputs to blank or unblank.
+     * \param blanked Whether the outputs should be blanked.
+     * \param blankedOutputs Filled with the names of the blanked or unblanked outputs.
+     * \param unknownOutputs Filled with the names which do not match any output.
+     * \return Whether the request succeeded.
+     */
+    bool blankOutputs(const QStringList& outputs, bool blanked, QStringList* blankedOutputs, QStringList* unknownOutputs);
+    /*!
+     * \brief Apply a profile
+     *
+     * Ask the daemon to apply the given profile (see QScreenResources::applyProfile()).
+     * \param name The name of the profile.
+     * \return Whether the request succeeded.
+     */
+    bool applyProfile(const QString& name);
+    /*!
+     * \brief Daemon statistics
+     *
+     * Ask the daemon for its request statistics (see QStats::report()).
+     * \param lines Filled with the lines of the report.
+     * \return Whether the request succeeded.
+     */
+    bool stats(QStringList* lines);
+private:
+    /*!
+     * \brief Send a request
+     *
+     * Send the given request to the daemon and wait for the reply.
+     * \param request The request line (without the line feed).
+     * \param lines Filled with the reply lines preceding the final line.
+     * \param result Filled with the argument of the final \c OK line.
+     * \return Whether the daemon replied with \c OK.
+     */
+    bool request(const QString& request, QStringList* lines, QString* result);
+
+    QLocalSocket mSocket;   /*!< The socket connected to the daemon */
+};
+
+#endif // QMONITORCLIENT_H
@@ -0,0 +1,152 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "qmonitorserver.h"
+#include "qmonitorclient.h"
+#include "qscreenresources.h"
+#include "qoutput.h"
+#include "qstats.h"
+
+#include <QDir>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QStandardPaths>
+
+#include <QtDebug>
+
+#include <unistd.h>
+
+QMonitorServer::QMonitorServer(QScreenResources* resources)
+    : mResources(resources)
+{
+    mServer.setSocketOptions(QLocalServer::UserAccessOption);
+    QObject::connect(&mServer, &QLocalServer::newConnection, [this] {
+        while (mServer.hasPendingConnections())
+            handleConnection(mServer.nextPendingConnection());
+    });
+}
+
+QString QMonitorServer::socketPath(void)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (!dir.isEmpty())
+        return QDir(dir).filePath("shutdownmonitor.sock");
+
+    // The temporary directory is shared by all the users:
+    return QDir(QDir::tempPath()).filePath(QString("shutdownmonitor-%1.sock").arg(getuid()));
+}
+
+bool QMonitorServer::listen(void)
+{
+    // Do not replace a running daemon:
+    QMonitorClient client;
+    if (client.connectToDaemon()) {
+        qWarning() << QObject::tr("Another daemon is already running");
+        return false;
+    }
+
+    // Remove a stale socket:
+    QLocalServer::removeServer(socketPath());
+    if (!mServer.listen(socketPath())) {
+        qWarning() << QObject::tr("Could not listen on %1. Error:").arg(socketPath()) << mServer.errorString();
+        return false;
+    }
+    return true;
+}
+
+void QMonitorServer::handleConnection(QLocalSocket* socket)
+{
+    QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    QObject::connect(socket, &QLocalSocket::readyRead, socket, [this, socket] {
+        while (socket->canReadLine())
+            handleRequest(socket, QString::fromUtf8(socket->readLine()).trimmed());
+    });
+}
+
+void QMonitorServer::handleRequest(QLocalSocket* socket, const QString& request)
+{
+    QString command = request.section(' ', 0, 0);
+    QString arguments = request.section(' ', 1);
+
+    if (command == "LIST") {
+        for (QOutput* output : mResources->outputs()) {
+            if (output->connection != QOutput::Connection::Connected)
+                continue;
+            socket->write(QString("OUTPUT %1 %2 %3\n").arg(output->name).arg(output->enabled() ? 1 : 0).arg(output->blanked() ? 1 : 0).toUtf8());
+        }
+        socket->write("OK\n");
+    } else if (command == "TOGGLE") {
+        QStringList unknownOutputs;
+        QList<QOutput*> outputs = mResources->resolveOutputs(arguments.split(',', Qt::SkipEmptyParts), &unknownOutputs);
+        foreach (QString name, unknownOutputs)
+            socket->write(QString("UNKNOWN %1\n").arg(name).toUtf8());
+
+        // Apply all the changes with only one reconfiguration:
+        QStringList toggledOutputs;
+        mResources->beginChanges();
+        foreach (QOutput* output, outputs) {
+            if (output->toggle())
+                toggledOutputs << output->name;
+        }
+
+        // The client may disconnect before the changes are applied:
+        QPointer<QLocalSocket> client(socket);
+        mResources->commitChangesAsync([client, toggledOutputs] (bool ok) {
+            if (client.isNull())
+                return;
+            if (ok)
+                client->write(QString("OK %1\n").arg(toggledOutputs.join(',')).toUtf8());
+            else
+                client->write("ERR Could not apply changes\n");
+        });
+    } else if ((command == "BLANK") || (command == "UNBLANK")) {
+        QStringList unknownOutputs;
+        QList<QOutput*> outputs = mResources->resolveOutputs(arguments.split(',', Qt::SkipEmptyParts), &unknownOutputs);
+        foreach (QString name, unknownOutputs)
+            socket->write(QString("UNKNOWN %1\n").arg(name).toUtf8());
+
+        // Blanking is immediate, as it does not change the layout:
+        QStringList blankedOutputs;
+        foreach (QOutput* output, outputs) {
+            if (mResources->blankOutput(output, command == "BLANK"))
+                blankedOutputs << output->name;
+        }
+        socket->write(QString("OK %1\n").arg(blankedOutputs.join(',')).toUtf8());
+    } else if (command == "PROFILE") {
+        // The client may disconnect before the profile is applied:
+        QPointer<QLocalSocket> client(socket);
+        mResources->applyProfileAsync(arguments, [client] (bool ok) {
+            if (client.isNull())
+                return;
+            if (ok)
+                client->write("OK\n");
+            else
+                client->write("ERR Could not apply profile\n");
+        });
+    } else if (command == "STATS") {
+        if (QStats::isEnabled()) {
+            foreach (QString line, QStats::report())
+                socket->write(QString("STAT %1\n").arg(line).toUtf8());
+            socket->write("OK\n");
+        } else {
+            socket->write("ERR Statistics are not collected (the daemon was started without --stats)\n");
+        }
+    } else {
+        socket->write(QString("ERR Unknown request: %1\n").arg(command).toUtf8());
+    }
+}
@@ -0,0 +1,103 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef QMONITORSERVER_H
+#define QMONITORSERVER_H
+
+#include <QLocalServer>
+#include <QString>
+
+class QLocalSocket;
+class QScreenResources;
+
+/*!
+ * \brief Daemon control server
+ *
+ * This class listens on a per-user UNIX socket and serves the requests
+ * of QMonitorClient instances with a resident screen resources instance.
+ *
+ * The protocol is line based. The requests are:
+ *   - \c LIST Lists the connected outputs. The server replies with one
+ *     \c OUTPUT \c \<name\> \c \<enabled\> \c \<blanked\> line per output, then \c OK.
+ *   - \c TOGGLE \c \<outputs\> Toggles the given outputs (comma-separated
+ *     names or glob patterns) in a single reconfiguration. The server replies
+ *     with one \c UNKNOWN \c \<name\> line per unknown output, then
+ *     \c OK \c \<toggled outputs\> (comma-separated list).
+ *   - \c BLANK \c \<outputs\> and \c UNBLANK \c \<outputs\> Blank or unblank the given outputs
+ *     (comma-separated names or glob patterns) without changing the layout. The server replies
+ *     with one \c UNKNOWN \c \<name\> line per unknown output, then
+ *     \c OK \c \<blanked or unblanked outputs\> (comma-separated list).
+ *   - \c PROFILE \c \<name\> Applies the given profile in a single reconfiguration.
+ *     The server replies with \c OK.
+ *   - \c STATS Dumps the request statistics (see QStats). The server replies
+ *     with one \c STAT \c \<line\> line per report line, then \c OK.
+ *     Statistics are only collected when the daemon was started with \c --stats.
+ *
+ * Errors are reported with an \c ERR \c \<message\> line.
+ */
+class QMonitorServer
+{
+public:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the server with the given screen resources.
+     * \param resources The screen resources used to serve the requests.
+     */
+    QMonitorServer(QScreenResources* resources);
+
+    /*!
+     * \brief Listen for clients
+     *
+     * Start listening on the per-user socket.
+     * A stale socket is removed, but the server fails if another daemon is running.
+     * \return Whether the server is listening.
+     * \sa socketPath()
+     */
+    bool listen(void);
+    /*!
+     * \brief Socket path
+     *
+     * Returns the path of the per-user socket. It is in the runtime directory of the user
+     * or, when there is none, in the temporary directory, with the user id in its name.
+     * The socket is only accessible to the user.
+     * \return The path of the per-user socket.
+     */
+    static QString socketPath(void);
+private:
+    /*!
+     * \brief Handle a new connection
+     *
+     * Read the requests of the new client.
+     * \param socket The socket of the new client.
+     */
+    void handleConnection(QLocalSocket* socket);
+    /*!
+     * \brief Handle a request
+     *
+     * Serve the given request and send the reply.
+     * \param socket The socket of the client.
+     * \param request The request line (without the line feed).
+     */
+    void handleRequest(QLocalSocket* socket, const QString& request);
+
+    QScreenResources* mResources;   /*!< The screen resources */
+    QLocalServer mServer;           /*!< The local server */
+};
+
+#endif // QMONITORSERVER_H
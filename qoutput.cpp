@@ -31,9 +31,31 @@ bool QOutput::disable(bool grab)
 
 bool QOutput::toggle(bool grab)
 {
-    if (mEnabled)
-        return mParent->disableOutput(this, grab);
-    else
-        return mParent->enableOutput(this, grab);
+    return mParent->toggleOutput(this, grab);
+}
+
+bool QOutput::blanked(void) const
+{
+    return mParent->mBlankedOutputs.contains(id);
+}
+
+bool QOutput::blank(void)
+{
+    return mParent->blankOutput(this, true);
+}
 
+bool QOutput::unblank(void)
+{
+    return mParent->blankOutput(this, false);
+}
+
+bool QOutput::toggleBlank(void)
+{
+    return mParent->toggleBlank(this);
+}
+
+void QOutput::setEnabled(bool enabled)
+{
+    mEnabled = enabled;
+    mParent->mLayout.setEnabled(id, enabled);
 }
@@ -19,9 +19,9 @@
 #ifndef QOUTPUT_H
 #define QOUTPUT_H
 
-#include <QString>
+#include "qscreenresources.h"
 
-class QScreenResources;
+#include <QString>
 
 /*!
  * \brief Internal representation for outputs
@@ -37,6 +37,7 @@ public:
         Connected,
     };
 
+    QOutputId id;               /*!< The output identifier */
     QString name;               /*!< The output name */
     int physicalWidth;          /*!< The physical width of this output (in mm) */
     int physicalHeight;         /*!< The physical height of this output (in mm) */
@@ -94,7 +95,51 @@ public:
      * \sa enable(), disable(), enabled()
      */
     bool toggle(bool grab = false);
+
+    /*!
+     * \brief Is blanked?
+     *
+     * Returns whether this output is currently blanked.
+     * \note A blanked output keeps its place in the layout.
+     * \return Whether this output is blanked.
+     * \sa blank(), unblank(), toggleBlank()
+     */
+    bool blanked(void) const;
+    /*!
+     * \brief Blank the output
+     *
+     * Darken the output, without changing the layout.
+     * \return Whether this output was successfully blanked.
+     * \sa unblank(), blanked()
+     */
+    bool blank(void);
+    /*!
+     * \brief Unblank the output
+     *
+     * Restore the output after it was blanked.
+     * \return Whether this output was successfully unblanked.
+     * \sa blank(), blanked()
+     */
+    bool unblank(void);
+    /*!
+     * \brief Toggle the blanking of the output
+     *
+     * Unblank the output if it is blanked, or
+     * blank the output if it is not.
+     * \return Whether this output was successfully blanked or unblanked.
+     * \sa blank(), unblank(), blanked()
+     */
+    bool toggleBlank(void);
 protected:
+    /*!
+     * \brief Change the enabled state
+     *
+     * Change the enabled state of this output
+     * and update the layout of the parent screen resources.
+     * \param enabled The new enabled state of this output.
+     */
+    void setEnabled(bool enabled);
+
     /*!
      * \brief Constructor
      *
@@ -102,7 +147,7 @@ protected:
      * \param parent The parent screen resources.
      */
     inline QOutput(QScreenResources *parent) :
-        mParent(parent), mEnabled(false) {}
+        id(0), mParent(parent), mEnabled(false) {}
 
     QScreenResources* mParent;    /*!< The parent screen resources */
     bool mEnabled;                /*!< The enabled state for this output */
@@ -0,0 +1,233 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "qoutputlayout.h"
+
+#include <limits>
+
+QOutputLayout::QOutputLayout(void) :
+    mTotal(empty()), mCurrent(empty())
+{}
+
+QOutputLayout::Bounds QOutputLayout::empty(void)
+{
+    Bounds bounds;
+    bounds.left = std::numeric_limits<int>::max();
+    bounds.top = std::numeric_limits<int>::max();
+    bounds.right = std::numeric_limits<int>::min();
+    bounds.bottom = std::numeric_limits<int>::min();
+    bounds.priority = std::numeric_limits<uint32_t>::max();
+    bounds.dirty = false;
+    return bounds;
+}
+
+QRect QOutputLayout::rect(const Bounds& bounds)
+{
+    if (bounds.left > bounds.right)
+        return QRect();
+    return QRect(QPoint(bounds.left, bounds.top), QPoint(bounds.right, bounds.bottom));
+}
+
+void QOutputLayout::set(QOutputId outputId, const QRect& rect, uint32_t priority, bool active, bool enabled)
+{
+    int slot = mSlots.value(outputId, -1);
+    if (slot < 0) {
+        slot = mIds.size();
+        mSlots.insert(outputId, slot);
+        mIds.append(outputId);
+        mLeft.append(0);
+        mTop.append(0);
+        mRight.append(0);
+        mBottom.append(0);
+        mPriorities.append(0);
+        mActive.append(0);
+        mHasRect.append(0);
+        mEnabled.append(0);
+    } else if (mActive.at(slot)) {
+        remove(mTotal, slot);
+        if (mEnabled.at(slot))
+            remove(mCurrent, slot);
+    }
+
+    QRect r = rect.normalized();
+    mLeft[slot] = r.left();
+    mTop[slot] = r.top();
+    mRight[slot] = r.right();
+    mBottom[slot] = r.bottom();
+    mPriorities[slot] = priority;
+    mActive[slot] = active;
+    mHasRect[slot] = !rect.isNull();
+    mEnabled[slot] = enabled;
+
+    if (active) {
+        add(mTotal, slot);
+        if (enabled)
+            add(mCurrent, slot);
+    }
+}
+
+void QOutputLayout::setEnabled(QOutputId outputId, bool enabled)
+{
+    int slot = mSlots.value(outputId, -1);
+    if ((slot < 0) || (mEnabled.at(slot) == enabled))
+        return;
+
+    mEnabled[slot] = enabled;
+    if (!mActive.at(slot))
+        return;
+    if (enabled)
+        add(mCurrent, slot);
+    else
+        remove(mCurrent, slot);
+}
+
+void QOutputLayout::remove(QOutputId outputId)
+{
+    int slot = mSlots.value(outputId, -1);
+    if (slot < 0)
+        return;
+
+    if (mActive.at(slot)) {
+        remove(mTotal, slot);
+        if (mEnabled.at(slot))
+            remove(mCurrent, slot);
+    }
+
+    // Move the last slot in place of the removed one:
+    int last = mIds.size() - 1;
+    if (slot != last) {
+        mIds[slot] = mIds.at(last);
+        mLeft[slot] = mLeft.at(last);
+        mTop[slot] = mTop.at(last);
+        mRight[slot] = mRight.at(last);
+        mBottom[slot] = mBottom.at(last);
+        mPriorities[slot] = mPriorities.at(last);
+        mActive[slot] = mActive.at(last);
+        mHasRect[slot] = mHasRect.at(last);
+        mEnabled[slot] = mEnabled.at(last);
+        mSlots.insert(mIds.at(slot), slot);
+    }
+    mSlots.remove(outputId);
+    mIds.removeLast();
+    mLeft.removeLast();
+    mTop.removeLast();
+    mRight.removeLast();
+    mBottom.removeLast();
+    mPriorities.removeLast();
+    mActive.removeLast();
+    mHasRect.removeLast();
+    mEnabled.removeLast();
+}
+
+void QOutputLayout::clear(void)
+{
+    mSlots.clear();
+    mIds.clear();
+    mLeft.clear();
+    mTop.clear();
+    mRight.clear();
+    mBottom.clear();
+    mPriorities.clear();
+    mActive.clear();
+    mHasRect.clear();
+    mEnabled.clear();
+    mTotal = empty();
+    mCurrent = empty();
+}
+
+QRect QOutputLayout::totalScreen(void) const
+{
+    if (mTotal.dirty)
+        recompute(mTotal, false);
+    return rect(mTotal);
+}
+
+QRect QOutputLayout::screen(void) const
+{
+    if (mCurrent.dirty)
+        recompute(mCurrent, true);
+    return rect(mCurrent);
+}
+
+uint32_t QOutputLayout::totalPriority(void) const
+{
+    if (mTotal.dirty)
+        recompute(mTotal, false);
+    return mTotal.priority != std::numeric_limits<uint32_t>::max() ? mTotal.priority : 0;
+}
+
+uint32_t QOutputLayout::priority(void) const
+{
+    if (mCurrent.dirty)
+        recompute(mCurrent, true);
+    return mCurrent.priority != std::numeric_limits<uint32_t>::max() ? mCurrent.priority : 0;
+}
+
+void QOutputLayout::add(Bounds& bounds, int slot) const
+{
+    if (bounds.dirty)
+        return;
+
+    if (mHasRect.at(slot)) {
+        bounds.left = qMin(bounds.left, mLeft.at(slot));
+        bounds.top = qMin(bounds.top, mTop.at(slot));
+        bounds.right = qMax(bounds.right, mRight.at(slot));
+        bounds.bottom = qMax(bounds.bottom, mBottom.at(slot));
+    }
+    bounds.priority = qMin(bounds.priority, mPriorities.at(slot));
+}
+
+void QOutputLayout::remove(Bounds& bounds, int slot) const
+{
+    if (bounds.dirty)
+        return;
+
+    // Only the slots on the boundary may shrink the bounds:
+    if (mHasRect.at(slot) && ((mLeft.at(slot) == bounds.left) || (mTop.at(slot) == bounds.top)
+                           || (mRight.at(slot) == bounds.right) || (mBottom.at(slot) == bounds.bottom)))
+        bounds.dirty = true;
+    if (mPriorities.at(slot) == bounds.priority)
+        bounds.dirty = true;
+}
+
+void QOutputLayout::recompute(Bounds& bounds, bool enabledOnly) const
+{
+    const int n = mIds.size();
+    const int* left = mLeft.constData();
+    const int* top = mTop.constData();
+    const int* right = mRight.constData();
+    const int* bottom = mBottom.constData();
+    const uint32_t* priorities = mPriorities.constData();
+    const quint8* active = mActive.constData();
+    const quint8* hasRect = mHasRect.constData();
+    const quint8* enabled = mEnabled.constData();
+    const quint8 enabledMask = enabledOnly ? 0 : 1;
+
+    // Branchless loop, so that the compiler can vectorize it:
+    Bounds ans = empty();
+    for (int s = 0; s < n; s++) {
+        const bool counted = active[s] & (enabled[s] | enabledMask);
+        const bool inRect = counted & hasRect[s];
+        ans.left = qMin(ans.left, inRect ? left[s] : std::numeric_limits<int>::max());
+        ans.top = qMin(ans.top, inRect ? top[s] : std::numeric_limits<int>::max());
+        ans.right = qMax(ans.right, inRect ? right[s] : std::numeric_limits<int>::min());
+        ans.bottom = qMax(ans.bottom, inRect ? bottom[s] : std::numeric_limits<int>::min());
+        ans.priority = qMin(ans.priority, counted ? priorities[s] : std::numeric_limits<uint32_t>::max());
+    }
+    bounds = ans;
+}
@@ -0,0 +1,187 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef QOUTPUTLAYOUT_H
+#define QOUTPUTLAYOUT_H
+
+#include <QHash>
+#include <QRect>
+#include <QVector>
+
+typedef unsigned long QOutputId;
+
+/*!
+ * \brief Output layout
+ *
+ * This class holds the rectangles, priorities and enabled states of the outputs
+ * in contiguous arrays (one slot per output), and maintains the bounding boxes
+ * and minimum priorities of all the outputs and of the enabled outputs only.
+ *
+ * The bounds are updated incrementally when an output is added or enabled.
+ * When an output on the boundary is removed or disabled, the bounds are marked dirty
+ * and recomputed on the next query, with a single pass over the arrays.
+ */
+class QOutputLayout
+{
+public:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize an empty layout.
+     */
+    QOutputLayout(void);
+
+    /*!
+     * \brief Set an output
+     *
+     * Add the given output to the layout, or update it if it already exists.
+     * \param outputId The output identifier.
+     * \param rect The rectangle of the output on the screen when all outputs are on.
+     * A null rectangle does not contribute to the bounding boxes.
+     * \param priority The priority of the output when all outputs are on.
+     * \param active Whether the output is taken into account (e.g. connected).
+     * \param enabled Whether the output is enabled.
+     * \sa remove(), setEnabled()
+     */
+    void set(QOutputId outputId, const QRect& rect, uint32_t priority, bool active, bool enabled);
+    /*!
+     * \brief Change the enabled state of an output
+     *
+     * Change the enabled state of the given output, if it is in the layout.
+     * \param outputId The output identifier.
+     * \param enabled Whether the output is enabled.
+     * \sa set()
+     */
+    void setEnabled(QOutputId outputId, bool enabled);
+    /*!
+     * \brief Remove an output
+     *
+     * Remove the given output from the layout, if it is in the layout.
+     * \param outputId The output identifier.
+     * \sa set(), clear()
+     */
+    void remove(QOutputId outputId);
+    /*!
+     * \brief Remove all outputs
+     *
+     * Remove all the outputs from the layout.
+     * \sa remove()
+     */
+    void clear(void);
+
+    /*!
+     * \brief Total screen
+     *
+     * Returns the screen rectangle when all outputs are on.
+     * \return The bounding box of all the active outputs.
+     * \sa screen()
+     */
+    QRect totalScreen(void) const;
+    /*!
+     * \brief Screen
+     *
+     * Returns the screen rectangle when only enabled outputs are on.
+     * \return The bounding box of the active enabled outputs.
+     * \sa totalScreen()
+     */
+    QRect screen(void) const;
+    /*!
+     * \brief Total minimum priority
+     *
+     * Returns the minimum priority when all outputs are on.
+     * \return The minimum priority of all the active outputs (0 if there is none).
+     * \sa priority()
+     */
+    uint32_t totalPriority(void) const;
+    /*!
+     * \brief Minimum priority
+     *
+     * Returns the minimum priority when only enabled outputs are on.
+     * \return The minimum priority of the active enabled outputs (0 if there is none).
+     * \sa totalPriority()
+     */
+    uint32_t priority(void) const;
+private:
+    /*!
+     * \brief Bounds
+     *
+     * Instances of this structure hold a bounding box and a minimum priority.
+     */
+    struct Bounds {
+        int left;           /*!< The left coordinate of the bounding box */
+        int top;            /*!< The top coordinate of the bounding box */
+        int right;          /*!< The right coordinate of the bounding box (included) */
+        int bottom;         /*!< The bottom coordinate of the bounding box (included) */
+        uint32_t priority;  /*!< The minimum priority */
+        bool dirty;         /*!< Whether the bounds should be recomputed */
+    };
+
+    /*!
+     * \brief Add a slot to bounds
+     *
+     * Extend the given bounds with the given slot.
+     * \param bounds The bounds to extend.
+     * \param slot The slot index.
+     */
+    void add(Bounds& bounds, int slot) const;
+    /*!
+     * \brief Remove a slot from bounds
+     *
+     * Mark the given bounds dirty if the given slot is on their boundary.
+     * \param bounds The bounds to update.
+     * \param slot The slot index.
+     */
+    void remove(Bounds& bounds, int slot) const;
+    /*!
+     * \brief Recompute bounds
+     *
+     * Recompute the given bounds with a single pass over the slots.
+     * \param bounds The bounds to recompute.
+     * \param enabledOnly Whether to consider only enabled outputs.
+     */
+    void recompute(Bounds& bounds, bool enabledOnly) const;
+    /*!
+     * \brief Convert bounds to a rectangle
+     *
+     * \param bounds The bounds to convert.
+     * \return The bounding box as a rectangle (null if empty).
+     */
+    static QRect rect(const Bounds& bounds);
+    /*!
+     * \brief Empty bounds
+     *
+     * \return Bounds which do not contain any slot.
+     */
+    static Bounds empty(void);
+
+    QHash<QOutputId, int> mSlots;   /*!< The slot index of each output */
+    QVector<QOutputId> mIds;        /*!< The output identifier of each slot */
+    QVector<int> mLeft;             /*!< The left coordinate of each slot */
+    QVector<int> mTop;              /*!< The top coordinate of each slot */
+    QVector<int> mRight;            /*!< The right coordinate of each slot (included) */
+    QVector<int> mBottom;           /*!< The bottom coordinate of each slot (included) */
+    QVector<uint32_t> mPriorities;  /*!< The priority of each slot */
+    QVector<quint8> mActive;        /*!< Whether each slot is active */
+    QVector<quint8> mHasRect;       /*!< Whether each slot has a non-null rectangle */
+    QVector<quint8> mEnabled;       /*!< Whether each slot is enabled */
+
+    mutable Bounds mTotal;          /*!< The bounds of all the active outputs */
+    mutable Bounds mCurrent;        /*!< The bounds of the active enabled outputs */
+};
+
+#endif // QOUTPUTLAYOUT_H
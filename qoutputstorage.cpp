@@ -0,0 +1,59 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "qoutputstorage.h"
+#include "qoutput.h"
+
+int QOutputStorage::lowerBound(QOutputId outputId) const
+{
+    auto it = std::lower_bound(mOutputs.constBegin(), mOutputs.constEnd(), outputId, [] (const QOutput* output, QOutputId id) {
+        return output->id < id;
+    });
+    return it - mOutputs.constBegin();
+}
+
+int QOutputStorage::indexOf(QOutputId outputId) const
+{
+    int i = lowerBound(outputId);
+    if ((i < mOutputs.size()) && (mOutputs.at(i)->id == outputId))
+        return i;
+    return -1;
+}
+
+void QOutputStorage::insert(QOutput* output)
+{
+    int i = lowerBound(output->id);
+    if ((i < mOutputs.size()) && (mOutputs.at(i)->id == output->id))
+        mOutputs[i] = output;
+    else
+        mOutputs.insert(i, output);
+}
+
+QOutput* QOutputStorage::take(QOutputId outputId)
+{
+    int i = indexOf(outputId);
+    if (i < 0)
+        return nullptr;
+    return mOutputs.takeAt(i);
+}
+
+void QOutputStorage::deleteAll(void)
+{
+    qDeleteAll(mOutputs);
+    mOutputs.clear();
+}
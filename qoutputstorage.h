@@ -0,0 +1,182 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef QOUTPUTSTORAGE_H
+#define QOUTPUTSTORAGE_H
+
+#include <QVector>
+
+#include <algorithm>
+#include <iterator>
+
+typedef unsigned long QOutputId;
+
+class QOutput;
+
+/*!
+ * \brief View on outputs
+ *
+ * Instances of this class are non-allocating ranges on the outputs
+ * of a QOutputStorage, which yield pointers to \p T.
+ * \note The view is invalidated when the storage is modified.
+ * \tparam T The output type, which is either QOutput or the output type of the backend.
+ */
+template<typename T>
+class QOutputView
+{
+public:
+    /*!
+     * \brief Iterator on outputs
+     *
+     * Instances of this class iterate on the outputs of a QOutputView.
+     */
+    class const_iterator
+    {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T* value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T* const* pointer;
+        typedef T* reference;
+
+        inline const_iterator(void) : mIt(nullptr) {}
+        inline explicit const_iterator(QOutput* const* it) : mIt(it) {}
+        inline T* operator*(void) const {return static_cast<T*>(*mIt);}
+        inline T* operator[](difference_type n) const {return static_cast<T*>(mIt[n]);}
+        inline const_iterator& operator++(void) {mIt++; return *this;}
+        inline const_iterator operator++(int) {return const_iterator(mIt++);}
+        inline const_iterator& operator--(void) {mIt--; return *this;}
+        inline const_iterator operator--(int) {return const_iterator(mIt--);}
+        inline const_iterator& operator+=(difference_type n) {mIt += n; return *this;}
+        inline const_iterator& operator-=(difference_type n) {mIt -= n; return *this;}
+        inline const_iterator operator+(difference_type n) const {return const_iterator(mIt + n);}
+        inline const_iterator operator-(difference_type n) const {return const_iterator(mIt - n);}
+        inline difference_type operator-(const const_iterator& other) const {return mIt - other.mIt;}
+        inline bool operator==(const const_iterator& other) const {return mIt == other.mIt;}
+        inline bool operator!=(const const_iterator& other) const {return mIt != other.mIt;}
+        inline bool operator<(const const_iterator& other) const {return mIt < other.mIt;}
+    private:
+        QOutput* const* mIt;    /*!< The current position */
+    };
+    typedef const_iterator iterator;
+
+    /*!
+     * \brief Constructor
+     *
+     * Initialize a view on the given range of outputs.
+     * \param begin The first output of the range.
+     * \param end The end of the range.
+     */
+    inline QOutputView(QOutput* const* begin, QOutput* const* end) :
+        mBegin(begin), mEnd(end) {}
+
+    inline const_iterator begin(void) const {return const_iterator(mBegin);}
+    inline const_iterator end(void) const {return const_iterator(mEnd);}
+    inline const_iterator constBegin(void) const {return begin();}
+    inline const_iterator constEnd(void) const {return end();}
+    inline int size(void) const {return mEnd - mBegin;}
+    inline bool isEmpty(void) const {return mEnd == mBegin;}
+    inline T* at(int i) const {return static_cast<T*>(mBegin[i]);}
+private:
+    QOutput* const* mBegin; /*!< The first output of the range */
+    QOutput* const* mEnd;   /*!< The end of the range */
+};
+
+/*!
+ * \brief Output storage
+ *
+ * This class stores the outputs in a contiguous array sorted by identifier.
+ * The lookup by identifier is a binary search, and the iteration does not allocate.
+ * \note The storage does not own the outputs.
+ */
+class QOutputStorage
+{
+public:
+    /*!
+     * \brief Get an output
+     *
+     * \param outputId The output identifier.
+     * \return The output with the given identifier, or \c nullptr if there is not any.
+     */
+    inline QOutput* value(QOutputId outputId) const {int i = indexOf(outputId); return i >= 0 ? mOutputs.at(i) : nullptr;}
+    /*!
+     * \brief Contains an output?
+     *
+     * \param outputId The output identifier.
+     * \return Whether there is an output with the given identifier.
+     */
+    inline bool contains(QOutputId outputId) const {return indexOf(outputId) >= 0;}
+    /*!
+     * \brief Insert an output
+     *
+     * Insert the given output at its position, according to its identifier.
+     * An output with the same identifier is replaced (but not deleted).
+     * \param output The output to insert.
+     */
+    void insert(QOutput* output);
+    /*!
+     * \brief Take an output
+     *
+     * Remove the output with the given identifier and return it.
+     * \param outputId The output identifier.
+     * \return The removed output, or \c nullptr if there is not any.
+     */
+    QOutput* take(QOutputId outputId);
+    /*!
+     * \brief Remove all outputs
+     *
+     * Remove all the outputs, without deleting them.
+     */
+    inline void clear(void) {mOutputs.clear();}
+    /*!
+     * \brief Remove and delete all outputs
+     *
+     * Remove all the outputs and delete them.
+     */
+    void deleteAll(void);
+
+    inline int size(void) const {return mOutputs.size();}
+    inline bool isEmpty(void) const {return mOutputs.isEmpty();}
+    /*!
+     * \brief View on the outputs
+     *
+     * \tparam T The type of the stored outputs.
+     * \return A non-allocating view on the outputs, sorted by identifier.
+     */
+    template<typename T = QOutput>
+    inline QOutputView<T> view(void) const {return QOutputView<T>(mOutputs.constData(), mOutputs.constData() + mOutputs.size());}
+private:
+    /*!
+     * \brief Index of an output
+     *
+     * \param outputId The output identifier.
+     * \return The index of the output with the given identifier, or -1 if there is not any.
+     */
+    int indexOf(QOutputId outputId) const;
+    /*!
+     * \brief Lower bound
+     *
+     * \param outputId The output identifier.
+     * \return The index of the first output whose identifier is not less than the given one.
+     */
+    int lowerBound(QOutputId outputId) const;
+
+    QVector<QOutput*> mOutputs; /*!< The outputs, sorted by identifier */
+};
+
+#endif // QOUTPUTSTORAGE_H
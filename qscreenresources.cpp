@@ -18,8 +18,39 @@
 
 #include "qscreenresources.h"
 #include "qoutput.h"
+#include "qstats.h"
+#include "qtracer.h"
 
-QList< QPair< QString, std::function<QScreenResources*(bool)> > > QScreenResources::availableBackends;
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QSettings>
+#include <QSharedPointer>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+
+#include <algorithm>
+
+QList<QScreenResources::Backend> QScreenResources::availableBackends;
+
+static QString statsOperation(const QOutputChanges& changes)
+{
+    // Only enabled or only disabled outputs:
+    QList<bool> states = changes.values();
+    if (!states.contains(false))
+        return "enable";
+    if (!states.contains(true))
+        return "disable";
+    return "toggle";
+}
 
 QStringList QScreenResources::listBackends(void)
 {
@@ -28,56 +59,586 @@ QStringList QScreenResources::listBackends(void)
     if (availableBackends.isEmpty())
         initBackends();
 
-    foreach (auto b, availableBackends)
-        ret.append(b.first);
+    foreach (Backend b, availableBackends)
+        ret.append(b.name);
     return ret;
 }
 
+QList<QScreenResources::BackendProbe> QScreenResources::probeBackends(int timeout)
+{
+    if (availableBackends.isEmpty())
+        initBackends();
+
+    QList<BackendProbe> ans = probe(availableBackends, timeout, nullptr);
+    return ans;
+}
+
 QScreenResources* QScreenResources::create(const QString& backend)
 {
+    QTraceScope trace("createResources");
+    QStatsOperation stats("create");
     if (availableBackends.isEmpty())
         initBackends();
 
-    foreach (auto b, availableBackends) {
-        if (!backend.isEmpty() && (QString::compare(backend, b.first, Qt::CaseInsensitive) != 0))
-            continue;
+    // Use the given backend:
+    if (!backend.isEmpty()) {
+        foreach (Backend b, availableBackends) {
+            if (QString::compare(backend, b.name, Qt::CaseInsensitive) == 0)
+                return b.create(true);
+        }
+        return nullptr;
+    }
+
+    // Try the backend which was chosen last time first:
+    QSettings state(QCoreApplication::organizationName(), "ShutdownMonitorState");
+    QString cachedBackend = state.value(backendCacheKey()).toString();
+    QList<Backend> backends = availableBackends;
+    for (int b = 0; b < backends.size(); b++) {
+        if (backends.at(b).name == cachedBackend) {
+            backends.move(b, 0);
+            break;
+        }
+    }
+
+    // Probe the backends concurrently:
+    QScreenResources* ans = nullptr;
+    probe(backends, probeTimeout, &ans);
+    if (ans != nullptr)
+        state.setValue(backendCacheKey(), ans->name);
+    else
+        state.remove(backendCacheKey());
+    return ans;
+}
+
+QString QScreenResources::displayKey(void)
+{
+    QString session = QString::fromLocal8Bit(qgetenv("XDG_SESSION_TYPE"));
+    QString display = QString::fromLocal8Bit(qgetenv("WAYLAND_DISPLAY"));
+    if (display.isEmpty())
+        display = QString::fromLocal8Bit(qgetenv("DISPLAY"));
+    return QString::fromLatin1(QUrl::toPercentEncoding(QString("%1@%2").arg(session, display)));
+}
+
+QString QScreenResources::backendCacheKey(void)
+{
+    return QString("backends/%1").arg(displayKey());
+}
+
+QString QScreenResources::snapshotPath(void)
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    return QDir(dir).filePath(QString("snapshot-%1.dat").arg(displayKey()));
+}
+
+bool QScreenResources::saveSnapshot(void) const
+{
+    // Keep the snapshot of a process which did not exit cleanly:
+    if (QFile::exists(snapshotPath())) {
+        qWarning() << QObject::tr("A layout snapshot already exists (use --restore to restore it): %1").arg(snapshotPath());
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(snapshotPath()).absolutePath());
+    QSaveFile file(snapshotPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << QObject::tr("Could not open snapshot file: %1").arg(snapshotPath()) << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << snapshotMagic << snapshotVersion << name;
+    writeSnapshot(stream);
+    if ((stream.status() != QDataStream::Ok) || !file.commit()) {
+        qWarning() << QObject::tr("Could not write snapshot file: %1").arg(snapshotPath()) << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool QScreenResources::restoreSnapshot(void)
+{
+    QFile file(snapshotPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << QObject::tr("Could not open snapshot file: %1").arg(snapshotPath()) << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic;
+    quint16 version;
+    QString backend;
+    stream >> magic >> version >> backend;
+    if ((stream.status() != QDataStream::Ok) || (magic != snapshotMagic) || (version != snapshotVersion)) {
+        qWarning() << QObject::tr("Invalid snapshot file: %1").arg(snapshotPath());
+        return false;
+    }
+    if (backend != name) {
+        qWarning() << QObject::tr("The snapshot was saved by the %1 backend, use --backend %1 to restore it").arg(backend);
+        return false;
+    }
+
+    QStatsOperation stats("restore");
+    if (!readSnapshot(stream))
+        return false;
+
+    file.close();
+    discardSnapshot();
+    return true;
+}
 
-        QScreenResources* ans = b.second(!backend.isEmpty());
-        if (ans != nullptr)
-            return ans;
+void QScreenResources::discardSnapshot(void)
+{
+    QFile::remove(snapshotPath());
+}
+
+QList<QScreenResources::BackendProbe> QScreenResources::probe(const QList<Backend>& backends, int timeout, QScreenResources** winner)
+{
+    // The state is shared with the probes which outlive this function:
+    struct ProbeState {
+        QVector<bool> finished;
+        QVector<QScreenResources*> resources;
+        QVector<qint64> times;
+        QEventLoop* loop;
+        bool done;
+    };
+    QSharedPointer<ProbeState> state(new ProbeState);
+    state->finished.fill(false, backends.size());
+    state->resources.fill(nullptr, backends.size());
+    state->times.fill(-1, backends.size());
+    state->done = false;
+
+    QEventLoop loop;
+    state->loop = &loop;
+
+    // Decide when all the probes are finished, or when the first usable backend in priority order is known:
+    auto decided = [state, winner] {
+        for (int b = 0; b < state->finished.size(); b++) {
+            if (!state->finished.at(b))
+                return false;
+            if ((winner != nullptr) && (state->resources.at(b) != nullptr))
+                return true;
+        }
+        return true;
+    };
+
+    // Start all the probes:
+    QElapsedTimer timer;
+    timer.start();
+    for (int b = 0; b < backends.size(); b++) {
+        const char* traceName = backends.at(b).traceName.constData();
+        qint64 traceBegin = QTracer::isEnabled() ? QTracer::now() : 0;
+        QProbeCallback callback = [state, b, timer, traceName, traceBegin] (QScreenResources* resources) {
+            if (QTracer::isEnabled())
+                QTracer::record(traceName, traceBegin, QTracer::now());
+
+            // Cancelled or timed out probe:
+            if (state->done || state->finished.at(b)) {
+                delete resources;
+                return;
+            }
+
+            state->finished[b] = true;
+            state->resources[b] = resources;
+            state->times[b] = timer.elapsed();
+            if (state->loop != nullptr)
+                state->loop->quit();
+        };
+
+        // The synchronous factories are run in threads, so that they are also bounded by the timeout:
+        if (backends.at(b).probe)
+            backends.at(b).probe(false, callback);
+        else
+            createInThread(backends.at(b).create, callback);
+    }
+
+    // Give up the probes which time out:
+    QTimer timeoutTimer;
+    timeoutTimer.setSingleShot(true);
+    QObject::connect(&timeoutTimer, &QTimer::timeout, [state] {
+        state->finished.fill(true);
+        state->loop->quit();
+    });
+    timeoutTimer.start(timeout);
+    while (!decided())
+        loop.exec();
+    state->done = true;
+    state->loop = nullptr;
+
+    // Keep the winner and cancel the other probes:
+    QList<BackendProbe> ans;
+    for (int b = 0; b < backends.size(); b++) {
+        BackendProbe p;
+        p.name = backends.at(b).name;
+        p.available = (state->resources.at(b) != nullptr);
+        p.time = state->times.at(b);
+        ans.append(p);
+
+        if ((winner != nullptr) && (*winner == nullptr) && (state->resources.at(b) != nullptr))
+            *winner = state->resources.at(b);
+        else
+            delete state->resources.at(b);
     }
-    return nullptr;
+    return ans;
+}
+
+void QScreenResources::createInThread(const std::function<QScreenResources*(bool)>& create, const QProbeCallback& callback)
+{
+    // The result is delivered in the calling thread, which will own the screen resources:
+    QThread* callerThread = QThread::currentThread();
+    QObject* receiver = new QObject();
+    QThread* thread = QThread::create([create, callback, callerThread, receiver] {
+        QScreenResources* resources = create(false);
+        if (resources != nullptr)
+            resources->moveToThread(callerThread);
+        QMetaObject::invokeMethod(receiver, [callback, resources] {
+            callback(resources);
+        }, Qt::QueuedConnection);
+    });
+
+    // The thread and the receiver are deleted once the thread finishes, even after the timeout
+    // (the result is queued before, so the callback still gets it to delete the screen resources).
+    // A thread blocked by a hung display server cannot be stopped: it is deleted when the server replies.
+    QObject::connect(thread, &QThread::finished, receiver, &QObject::deleteLater);
+    QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
 }
 
 QScreenResources::~QScreenResources(void)
 {
-    qDeleteAll(mOutputs);
+    mOutputs.deleteAll();
 }
 
 QOutput* QScreenResources::output(QOutputId outputId) const
 {
-    return mOutputs.value(outputId, nullptr);
+    return mOutputs.value(outputId);
 }
 
-QOutput* QScreenResources::output(const QString& name) const
+QList<QOutput*> QScreenResources::resolveOutputs(const QStringList& patterns, QStringList* unknown) const
 {
-    foreach (QOutputId outputId, outputs()) {
-        QOutput* output = mOutputs.value(outputId, nullptr);
-        if (output == nullptr)
-            continue;
+    static const QRegularExpression globCharacters("[*?\\[]");
+    QList<QRegularExpression> globs;
+    QStringList globPatterns;
+    QSet<QOutput*> matches;
+
+    // Exact names are looked up in the index, globs are matched in a single pass:
+    foreach (QString pattern, patterns) {
+        if (pattern.contains(globCharacters)) {
+            globs << QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern));
+            globPatterns << pattern;
+        } else if (mNameIndex.contains(pattern)) {
+            matches.insert(mNameIndex.value(pattern));
+        } else if (unknown != nullptr) {
+            *unknown << pattern;
+        }
+    }
+
+    if (!globs.isEmpty()) {
+        QVector<bool> matched(globs.size(), false);
+        for (QOutput* output : mOutputs.view()) {
+            if (output->connection != QOutput::Connection::Connected)
+                continue;
+            for (int g = 0; g < globs.size(); g++) {
+                if (globs.at(g).match(output->name).hasMatch()) {
+                    matches.insert(output);
+                    matched[g] = true;
+                }
+            }
+        }
+        for (int g = 0; (unknown != nullptr) && (g < globs.size()); g++) {
+            if (!matched.at(g))
+                *unknown << globPatterns.at(g);
+        }
+    }
+
+    // Keep the outputs sorted by identifier:
+    QList<QOutput*> ans = matches.values();
+    std::sort(ans.begin(), ans.end(), [] (const QOutput* o1, const QOutput* o2) {
+        return o1->id < o2->id;
+    });
+    return ans;
+}
+
+void QScreenResources::removeOutputsExcept(const QSet<QOutputId>& outputIds)
+{
+    QList<QOutputId> removedIds;
+    for (QOutput* output : mOutputs.view()) {
+        if (!outputIds.contains(output->id))
+            removedIds << output->id;
+    }
+
+    foreach (QOutputId outputId, removedIds) {
+        mBlankedOutputs.remove(outputId);
+        mLayout.remove(outputId);
+        delete mOutputs.take(outputId);
+    }
+}
+
+void QScreenResources::updateNameIndex(void)
+{
+    mNameIndex.clear();
+    mNameIndex.reserve(mOutputs.size());
+    for (QOutput* output : mOutputs.view()) {
         if (output->connection != QOutput::Connection::Connected)
             continue;
-        if (QString::compare(output->name, name, Qt::CaseSensitive) == 0)
-            return output;
+        // When names are duplicated, the output with the lowest identifier wins:
+        if (!mNameIndex.contains(output->name))
+            mNameIndex.insert(output->name, output);
     }
 
-    return nullptr;
+    // The compiled profiles are only valid for the same connected outputs:
+    QMap<QString, QOutputId> topology;
+    for (auto it = mNameIndex.constBegin(); it != mNameIndex.constEnd(); it++)
+        topology.insert(it.key(), it.value()->id);
+    if (topology != mTopology) {
+        mTopology = topology;
+        mProfilePlans.clear();
+    }
+
+    if (mChangeCallback)
+        mChangeCallback();
+}
+
+QStringList QScreenResources::profiles(void)
+{
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.beginGroup("profiles");
+    return settings.childKeys();
 }
 
-QList<QOutputId> QScreenResources::outputs(bool refresh)
+bool QScreenResources::compileProfile(const QString& name, QOutputChanges* plan)
+{
+    auto it = mProfilePlans.constFind(name);
+    if (it != mProfilePlans.constEnd()) {
+        *plan = it.value();
+        return true;
+    }
+
+    // Read the profile:
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.beginGroup("profiles");
+    if (!settings.contains(name)) {
+        qWarning() << QObject::tr("Unknown profile: %1").arg(name);
+        return false;
+    }
+
+    // Enable the outputs of the profile and disable the other ones:
+    QStringList unknownOutputs;
+    QList<QOutput*> enabledOutputs = resolveOutputs(settings.value(name).toStringList(), &unknownOutputs);
+    foreach (QString output, unknownOutputs)
+        qWarning() << QObject::tr("Unknown output in profile %1: %2").arg(name, output);
+    plan->clear();
+    foreach (QOutput* output, mNameIndex)
+        plan->insert(output->id, enabledOutputs.contains(output));
+
+    mProfilePlans.insert(name, *plan);
+    return true;
+}
+
+bool QScreenResources::applyProfile(const QString& name, bool grab)
+{
+    QOutputChanges plan;
+    if (!compileProfile(name, &plan))
+        return false;
+
+    QStatsOperation stats("profile");
+    return applyChanges(plan, grab);
+}
+
+void QScreenResources::applyProfileAsync(const QString& name, const QOperationCallback& callback, bool grab)
+{
+    QOutputChanges plan;
+    if (!compileProfile(name, &plan)) {
+        callback(false);
+        return;
+    }
+
+    QStatsOperation stats("profile");
+    applyChangesAsync(plan, callback, grab);
+}
+
+bool QScreenResources::blankOutput(QOutput* output, bool blanked)
+{
+    if (output == nullptr)
+        return false;
+
+    // Nothing to do:
+    if (output->blanked() == blanked)
+        return true;
+
+    QStatsOperation stats(blanked ? "blank" : "unblank");
+    if (!blank(output, blanked))
+        return false;
+
+    if (blanked)
+        mBlankedOutputs.insert(output->id);
+    else
+        mBlankedOutputs.remove(output->id);
+    return true;
+}
+
+bool QScreenResources::toggleBlank(QOutput* output)
+{
+    if (output == nullptr)
+        return false;
+
+    return blankOutput(output, !output->blanked());
+}
+
+bool QScreenResources::blank(QOutput* output, bool blanked)
+{
+    Q_UNUSED(output);
+    Q_UNUSED(blanked);
+
+    qWarning() << QObject::tr("The %1 backend cannot blank the outputs").arg(name);
+    return false;
+}
+
+QOutputView<QOutput> QScreenResources::outputs(bool refresh)
 {
     if (mOutputs.isEmpty() || refresh)
         refreshOutputs();
 
-    return mOutputs.keys();
+    return mOutputs.view();
+}
+
+bool QScreenResources::changeOutput(QOutput* output, bool enable, bool grab)
+{
+    if (output == nullptr)
+        return false;
+
+    if (mTransaction) {
+        mPendingChanges.insert(output->id, enable);
+        return true;
+    }
+
+    QOutputChanges changes;
+    changes.insert(output->id, enable);
+    return applyChanges(changes, grab);
+}
+
+bool QScreenResources::toggleOutput(QOutput* output, bool grab)
+{
+    if (output == nullptr)
+        return false;
+
+    bool enabled = mTransaction ? mPendingChanges.value(output->id, output->enabled()) : output->enabled();
+    return changeOutput(output, !enabled, grab);
+}
+
+void QScreenResources::beginChanges(void)
+{
+    mTransaction = true;
+    mPendingChanges.clear();
+}
+
+bool QScreenResources::commitChanges(bool grab)
+{
+    QOutputChanges changes = mPendingChanges;
+
+    mTransaction = false;
+    mPendingChanges.clear();
+    return applyChanges(changes, grab);
+}
+
+void QScreenResources::cancelChanges(void)
+{
+    mTransaction = false;
+    mPendingChanges.clear();
+}
+
+bool QScreenResources::applyChanges(const QOutputChanges& changes, bool grab)
+{
+    QOutputChanges effectiveChanges;
+    if (!filterChanges(changes, &effectiveChanges))
+        return false;
+
+    // Nothing to do:
+    if (effectiveChanges.isEmpty())
+        return true;
+
+    QStatsOperation stats(statsOperation(effectiveChanges));
+    return apply(effectiveChanges, grab);
+}
+
+void QScreenResources::changeOutputAsync(QOutput* output, bool enable, const QOperationCallback& callback, bool grab)
+{
+    if (output == nullptr) {
+        callback(false);
+        return;
+    }
+
+    if (mTransaction) {
+        mPendingChanges.insert(output->id, enable);
+        callback(true);
+        return;
+    }
+
+    QOutputChanges changes;
+    changes.insert(output->id, enable);
+    applyChangesAsync(changes, callback, grab);
+}
+
+void QScreenResources::toggleOutputAsync(QOutput* output, const QOperationCallback& callback, bool grab)
+{
+    if (output == nullptr) {
+        callback(false);
+        return;
+    }
+
+    bool enabled = mTransaction ? mPendingChanges.value(output->id, output->enabled()) : output->enabled();
+    changeOutputAsync(output, !enabled, callback, grab);
+}
+
+void QScreenResources::commitChangesAsync(const QOperationCallback& callback, bool grab)
+{
+    QOutputChanges changes = mPendingChanges;
+
+    mTransaction = false;
+    mPendingChanges.clear();
+    applyChangesAsync(changes, callback, grab);
+}
+
+void QScreenResources::applyChangesAsync(const QOutputChanges& changes, const QOperationCallback& callback, bool grab)
+{
+    QOutputChanges effectiveChanges;
+    if (!filterChanges(changes, &effectiveChanges)) {
+        callback(false);
+        return;
+    }
+
+    // Nothing to do:
+    if (effectiveChanges.isEmpty()) {
+        callback(true);
+        return;
+    }
+
+    QStatsOperation stats(statsOperation(effectiveChanges));
+    applyAsync(effectiveChanges, grab, callback);
+}
+
+void QScreenResources::applyAsync(const QOutputChanges& changes, bool grab, const QOperationCallback& callback)
+{
+    callback(apply(changes, grab));
+}
+
+void QScreenResources::refreshOutputsAsync(const std::function<void(void)>& callback)
+{
+    refreshOutputs();
+    callback();
+}
+
+bool QScreenResources::filterChanges(const QOutputChanges& changes, QOutputChanges* effectiveChanges) const
+{
+    // Drop the changes which do not modify the output state:
+    for (auto it = changes.constBegin(); it != changes.constEnd(); it++) {
+        QOutput* o = output(it.key());
+        if (o == nullptr)
+            return false;
+        if (o->enabled() != it.value())
+            effectiveChanges->insert(it.key(), it.value());
+    }
+
+    return true;
 }
@@ -19,11 +19,25 @@
 #ifndef QSCREENRESOURCES_H
 #define QSCREENRESOURCES_H
 
+#include "qoutputlayout.h"
+#include "qoutputstorage.h"
+
+#include <QHash>
 #include <QMap>
+#include <QSet>
+
+#include <functional>
 
 typedef unsigned long QOutputId;
+typedef QMap<QOutputId, bool> QOutputChanges;
+typedef std::function<void(bool)> QOperationCallback;
 
 class QOutput;
+class QScreenResources;
+class QDataStream;
+class QThread;
+
+typedef std::function<void(QScreenResources*)> QProbeCallback;
 
 /*!
  * \brief Internal reprsentation for screen resources
@@ -34,6 +48,18 @@ class QOutput;
 class QScreenResources
 {
 public:
+    /*!
+     * \brief Backend probe result
+     *
+     * Instances of this structure describe the result of a backend probe.
+     * \sa probeBackends()
+     */
+    struct BackendProbe {
+        QString name;   /*!< The name of the backend */
+        bool available; /*!< Whether the backend can be used */
+        qint64 time;    /*!< The duration of the probe (in ms), or -1 if it timed out */
+    };
+
     QString name;   /*!< Name of the backend */
 
     /*!
@@ -43,11 +69,25 @@ public:
      * \return The list of the available backend names.
      */
     static QStringList listBackends(void);
+    /*!
+     * \brief Probe available backends
+     *
+     * This function probes all the available backends concurrently
+     * and measures the duration of each probe.
+     * \param timeout The timeout of the probes (in ms).
+     * \return The probe results, in priority order.
+     */
+    static QList<BackendProbe> probeBackends(int timeout = probeTimeout);
     /*!
      * \brief Creates screen resources
      *
      * This function creates a new screen resources instance,
      * using the given backend, if any, or the prefered backend.
+     *
+     * When no backend is given, all the backends are probed concurrently,
+     * and the first usable backend in priority order wins.
+     * The backend which was chosen last time for the current session and display
+     * is tried first. The losing probes are cancelled.
      * \param backend The name of the preferred backend
      * \return A new screen resource instance.
      */
@@ -61,22 +101,23 @@ public:
     /*!
      * \brief Get all outputs
      *
-     * Get a QList of the identifiers of all outputs.
+     * Get a view on all outputs, sorted by identifier.
      * Refresh the output cache if needed.
+     * \note The view does not allocate, but it is invalidated when the output cache is refreshed.
      * \param refresh Whether the cached output list should be refreshed.
-     * \return The list of the identifiers of all outputs.
+     * \return A view on all outputs.
      * \sa outputs()
      */
-    QList<QOutputId> outputs(bool refresh = false);
+    QOutputView<QOutput> outputs(bool refresh = false);
     /*!
      * \brief Get all outputs
      *
-     * Get a QList of the identifiers of all outputs.
+     * Get a view on all outputs, sorted by identifier.
      * \note Do not refresh the output cache.
-     * \return The list of the identifiers of all outputs.
+     * \return A view on all outputs.
      * \sa outputs(bool)
      */
-    inline QList<QOutputId> outputs(void) const {return mOutputs.keys();}
+    inline QOutputView<QOutput> outputs(void) const {return mOutputs.view();}
 
     /*!
      * \brief Get an output by its id
@@ -90,31 +131,285 @@ public:
      * \brief Get an output by its name
      *
      * Get a pointer to the output internal representation corresponding to the given name.
+     * \note Only connected outputs are found.
      * \param name The desired output name.
      * \return The output internal representation corresponding to the given name.
      */
-    QOutput* output(const QString& name) const;
+    inline QOutput* output(const QString& name) const {return mNameIndex.value(name, nullptr);}
+    /*!
+     * \brief Resolve output names
+     *
+     * Get the connected outputs corresponding to the given names or glob patterns
+     * (e.g. \c HDMI-*), in a single pass on the outputs.
+     * \param patterns The output names or glob patterns.
+     * \param unknown If not \c nullptr, filled with the names or patterns which do not match any output.
+     * \return The matching outputs, sorted by identifier, without duplicates.
+     * \sa output(const QString&)
+     */
+    QList<QOutput*> resolveOutputs(const QStringList& patterns, QStringList* unknown = nullptr) const;
 
     /*!
      * \brief Enable the given output
      *
      * Enable the given output.
+     * \note When a transaction is in progress, the change is only recorded
+     * and it is applied by commitChanges().
      * \param output The output to enable.
      * \param grab Whether to grab the X display.
      * \return Whether this output was successfully enabled.
-     * \sa disableOutput()
+     * \sa disableOutput(), toggleOutput()
      */
-    virtual bool enableOutput(QOutput* output, bool grab = false) = 0;
+    inline bool enableOutput(QOutput* output, bool grab = false) {return changeOutput(output, true, grab);}
     /*!
      * \brief Disable the given output
      *
      * Disable the given output.
+     * \note When a transaction is in progress, the change is only recorded
+     * and it is applied by commitChanges().
      * \param output The output to disable.
      * \param grab Whether to grab the X display.
      * \return Whether this output was successfully disabled.
-     * \sa enableOutput()
+     * \sa enableOutput(), toggleOutput()
+     */
+    inline bool disableOutput(QOutput* output, bool grab = false) {return changeOutput(output, false, grab);}
+    /*!
+     * \brief Toggle the given output
+     *
+     * Disable the given output if it is enabled, or
+     * enable the given output if it is disabled.
+     * \note When a transaction is in progress, the pending state
+     * of the output is toggled.
+     * \param output The output to toggle.
+     * \param grab Whether to grab the X display.
+     * \return Whether this output was successfully toggled.
+     * \sa enableOutput(), disableOutput()
+     */
+    bool toggleOutput(QOutput* output, bool grab = false);
+
+    /*!
+     * \brief Begin a transaction
+     *
+     * Start recording the output changes instead of applying them.
+     * The recorded changes are applied at once by commitChanges().
+     * \sa commitChanges(), cancelChanges()
+     */
+    void beginChanges(void);
+    /*!
+     * \brief Commit a transaction
+     *
+     * Apply all the output changes recorded since beginChanges()
+     * in a single reconfiguration and end the transaction.
+     * \param grab Whether to grab the X display.
+     * \return Whether the changes were successfully applied.
+     * \sa beginChanges(), cancelChanges()
+     */
+    bool commitChanges(bool grab = false);
+    /*!
+     * \brief Cancel a transaction
+     *
+     * Discard all the output changes recorded since beginChanges()
+     * and end the transaction.
+     * \sa beginChanges(), commitChanges()
+     */
+    void cancelChanges(void);
+    /*!
+     * \brief Is a transaction in progress?
+     *
+     * Returns whether output changes are currently being recorded.
+     * \return Whether a transaction is in progress.
+     * \sa beginChanges()
+     */
+    inline bool inTransaction(void) const {return mTransaction;}
+
+    /*!
+     * \brief Apply a change set
+     *
+     * Apply the given output changes in a single reconfiguration.
+     * The changes which do not modify the state of the output are dropped.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * \param grab Whether to grab the X display.
+     * \return Whether the changes were successfully applied.
+     * \sa beginChanges(), commitChanges()
+     */
+    bool applyChanges(const QOutputChanges& changes, bool grab = false);
+
+    /*!
+     * \brief Enable the given output asynchronously
+     *
+     * Enable the given output without blocking the caller.
+     * \note When a transaction is in progress, the change is only recorded
+     * and the callback is called immediately.
+     * \param output The output to enable.
+     * \param callback The function called with the result of the operation.
+     * \param grab Whether to grab the X display.
+     * \sa enableOutput(), disableOutputAsync(), toggleOutputAsync()
      */
-    virtual bool disableOutput(QOutput* output, bool grab = false) = 0;
+    inline void enableOutputAsync(QOutput* output, const QOperationCallback& callback, bool grab = false) {changeOutputAsync(output, true, callback, grab);}
+    /*!
+     * \brief Disable the given output asynchronously
+     *
+     * Disable the given output without blocking the caller.
+     * \note When a transaction is in progress, the change is only recorded
+     * and the callback is called immediately.
+     * \param output The output to disable.
+     * \param callback The function called with the result of the operation.
+     * \param grab Whether to grab the X display.
+     * \sa disableOutput(), enableOutputAsync(), toggleOutputAsync()
+     */
+    inline void disableOutputAsync(QOutput* output, const QOperationCallback& callback, bool grab = false) {changeOutputAsync(output, false, callback, grab);}
+    /*!
+     * \brief Toggle the given output asynchronously
+     *
+     * Toggle the given output without blocking the caller.
+     * \note When a transaction is in progress, the change is only recorded
+     * and the callback is called immediately.
+     * \param output The output to toggle.
+     * \param callback The function called with the result of the operation.
+     * \param grab Whether to grab the X display.
+     * \sa toggleOutput(), enableOutputAsync(), disableOutputAsync()
+     */
+    void toggleOutputAsync(QOutput* output, const QOperationCallback& callback, bool grab = false);
+    /*!
+     * \brief Commit a transaction asynchronously
+     *
+     * Apply all the output changes recorded since beginChanges()
+     * without blocking the caller and end the transaction.
+     * \param callback The function called with the result of the operation.
+     * \param grab Whether to grab the X display.
+     * \sa commitChanges()
+     */
+    void commitChangesAsync(const QOperationCallback& callback, bool grab = false);
+    /*!
+     * \brief Apply a change set asynchronously
+     *
+     * Apply the given output changes in a single reconfiguration
+     * without blocking the caller.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * \param callback The function called with the result of the operation.
+     * \param grab Whether to grab the X display.
+     * \sa applyChanges()
+     */
+    void applyChangesAsync(const QOutputChanges& changes, const QOperationCallback& callback, bool grab = false);
+
+    /*!
+     * \brief Can outputs be blanked?
+     *
+     * Returns whether this backend can blank the outputs without changing the layout.
+     * \return Whether the outputs can be blanked.
+     * \sa blankOutput()
+     */
+    virtual bool canBlank(void) const {return false;}
+    /*!
+     * \brief Blank the given output
+     *
+     * Darken the given output, or restore it, without any modeset:
+     * the geometry and the CRTC assignment are left untouched,
+     * so that the windows are not moved.
+     * \note Blanking is not part of transactions, it is applied immediately.
+     * \param output The output to blank or unblank.
+     * \param blanked Whether the output should be blanked.
+     * \return Whether the output was successfully blanked or unblanked.
+     * \sa canBlank(), toggleBlank(), QOutput::blanked()
+     */
+    bool blankOutput(QOutput* output, bool blanked = true);
+    /*!
+     * \brief Toggle the blanking of the given output
+     *
+     * Unblank the given output if it is blanked, or
+     * blank the given output if it is not.
+     * \param output The output to blank or unblank.
+     * \return Whether the output was successfully blanked or unblanked.
+     * \sa blankOutput()
+     */
+    bool toggleBlank(QOutput* output);
+
+    /*!
+     * \brief List profiles
+     *
+     * Lists the profiles defined in the \c [profiles] group of the configuration file.
+     * Each profile lists the names or glob patterns of the outputs it enables
+     * (comma-separated list), the other connected outputs are disabled.
+     * \return The names of the profiles.
+     */
+    static QStringList profiles(void);
+    /*!
+     * \brief Apply a profile
+     *
+     * Apply the given profile in a single reconfiguration.
+     * The profile is compiled into the target state of each connected output
+     * the first time it is applied, and the compiled plan is cached
+     * until the connected outputs change.
+     * \param name The name of the profile.
+     * \param grab Whether to grab the X display.
+     * \return Whether the profile was successfully applied.
+     * \sa profiles()
+     */
+    bool applyProfile(const QString& name, bool grab = false);
+    /*!
+     * \brief Apply a profile asynchronously
+     *
+     * Apply the given profile in a single reconfiguration without blocking the caller.
+     * \param name The name of the profile.
+     * \param callback The function called with the result of the operation.
+     * \param grab Whether to grab the X display.
+     * \sa applyProfile()
+     */
+    void applyProfileAsync(const QString& name, const QOperationCallback& callback, bool grab = false);
+    /*!
+     * \brief Refresh the cached output list asynchronously
+     *
+     * Refresh the cached output list without blocking the caller.
+     * \param callback The function called when the output list is refreshed.
+     * \sa outputs(bool)
+     */
+    inline void refreshAsync(const std::function<void(void)>& callback) {refreshOutputsAsync(callback);}
+    /*!
+     * \brief Set the change callback
+     *
+     * Set the function called whenever the backend updates its output list,
+     * e.g. when an output is connected or disconnected, or when the outputs are refreshed.
+     * The X11 and Wlr backends track the changes of the display server,
+     * the other backends only notify the refreshes.
+     * \param callback The function called when the outputs change.
+     * \sa outputs(bool)
+     */
+    inline void setChangeCallback(const std::function<void(void)>& callback) {mChangeCallback = callback;}
+
+    /*!
+     * \brief Save a snapshot of the layout
+     *
+     * Save the current layout (as set in the backend) in the snapshot file,
+     * so that it can be restored even if the process is killed.
+     * An existing snapshot is kept, since it was left by a process which did not exit cleanly,
+     * and the current layout may not be the original one.
+     * \return Whether a new snapshot was saved.
+     * \sa restoreSnapshot(), discardSnapshot()
+     */
+    bool saveSnapshot(void) const;
+    /*!
+     * \brief Restore the snapshot of the layout
+     *
+     * Restore the layout saved in the snapshot file in a single reconfiguration,
+     * and remove the snapshot file on success.
+     * \note This function is synchronous: the KScreen backend waits for the new configuration
+     * in a nested event loop. It is only used by \c --restore, which has nothing else to do.
+     * \return Whether the snapshot was restored.
+     * \sa saveSnapshot()
+     */
+    bool restoreSnapshot(void);
+    /*!
+     * \brief Discard the snapshot of the layout
+     *
+     * Remove the snapshot file, once the original layout has been restored.
+     * \sa saveSnapshot()
+     */
+    static void discardSnapshot(void);
+    /*!
+     * \brief Snapshot file path
+     *
+     * \return The path of the snapshot file for the current session type and display.
+     */
+    static QString snapshotPath(void);
 protected:
     /*!
      * \brief Constructor
@@ -124,24 +419,236 @@ protected:
      * \sa create()
      */
     inline QScreenResources(const QString& name) :
-        name(name) {}
+        name(name), mTransaction(false) {}
     /*!
      * \brief Refresh the cached output list
      *
      * Refresh the QList of output internal representations.
      */
     virtual void refreshOutputs(void) = 0;
+    /*!
+     * \brief Apply output changes
+     *
+     * Apply the given output changes in a single reconfiguration.
+     * Backends implement this function. On failure, the output states
+     * should be left unchanged.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * It only contains outputs whose state actually changes.
+     * \param grab Whether to grab the X display.
+     * \return Whether the changes were successfully applied.
+     * \sa applyChanges()
+     */
+    virtual bool apply(const QOutputChanges& changes, bool grab) = 0;
+    /*!
+     * \brief Apply output changes asynchronously
+     *
+     * Apply the given output changes in a single reconfiguration
+     * and call the callback with the result.
+     * The default implementation calls apply() and then the callback.
+     * Backends with asynchronous operations should reimplement it.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * It only contains outputs whose state actually changes.
+     * \param grab Whether to grab the X display.
+     * \param callback The function called with the result of the operation.
+     * \sa apply(), applyChangesAsync()
+     */
+    virtual void applyAsync(const QOutputChanges& changes, bool grab, const QOperationCallback& callback);
+    /*!
+     * \brief Refresh the cached output list asynchronously
+     *
+     * Refresh the QList of output internal representations
+     * and call the callback when it is done.
+     * The default implementation calls refreshOutputs() and then the callback.
+     * Backends with asynchronous operations should reimplement it.
+     * \param callback The function called when the output list is refreshed.
+     * \sa refreshOutputs(), refreshAsync()
+     */
+    virtual void refreshOutputsAsync(const std::function<void(void)>& callback);
+    /*!
+     * \brief Write a snapshot
+     *
+     * Write the current layout to the given stream.
+     * Backends implement this function with the information they need to restore the layout.
+     * \param stream The snapshot stream.
+     * \sa saveSnapshot(), readSnapshot()
+     */
+    virtual void writeSnapshot(QDataStream& stream) const = 0;
+    /*!
+     * \brief Apply a snapshot
+     *
+     * Read the layout from the given stream and apply it in a single reconfiguration.
+     * On failure, the output states should be left unchanged.
+     * \param stream The snapshot stream, as written by writeSnapshot().
+     * \return Whether the layout was restored.
+     * \sa restoreSnapshot()
+     */
+    virtual bool readSnapshot(QDataStream& stream) = 0;
+    /*!
+     * \brief Blank an output
+     *
+     * Darken the given output, or restore it, without changing the layout.
+     * Backends which can blank the outputs reimplement this function and canBlank().
+     * The default implementation fails.
+     * \param output The output to blank or unblank.
+     * \param blanked Whether the output should be blanked.
+     * \return Whether the output was successfully blanked or unblanked.
+     * \sa blankOutput()
+     */
+    virtual bool blank(QOutput* output, bool blanked);
+    /*!
+     * \brief Move to another thread
+     *
+     * Move the internal objects of the backend (timers, socket notifiers, ...) to the given thread,
+     * which will use the screen resources. This function must be called in the thread which created them.
+     * Backends which have such objects reimplement this function. The default implementation does nothing.
+     * \param thread The thread which will use the screen resources.
+     */
+    virtual void moveToThread(QThread* thread) {Q_UNUSED(thread);}
+    /*!
+     * \brief Remove outputs
+     *
+     * Remove and delete all the outputs whose identifier is not in the given set.
+     * \param outputIds The identifiers of the outputs to keep.
+     */
+    void removeOutputsExcept(const QSet<QOutputId>& outputIds);
+    /*!
+     * \brief Update the name index
+     *
+     * Update the index of the connected outputs by name,
+     * and drop the compiled profiles when the connected outputs change.
+     * Backends call this function whenever they refresh the outputs,
+     * so that the change callback is notified.
+     * \sa output(const QString&), resolveOutputs(), setChangeCallback()
+     */
+    void updateNameIndex(void);
 
-    QMap<QOutputId, QOutput*> mOutputs; /*!< The list of output internal representations */
+    QOutputStorage mOutputs;    /*!< The output internal representations, sorted by identifier */
+    QOutputLayout mLayout;      /*!< The layout of the outputs, kept in sync by the backends */
 private:
+    /*!
+     * \brief Change the given output state
+     *
+     * Record the new output state if a transaction is in progress,
+     * otherwise apply it immediately.
+     * \param output The output to change.
+     * \param enable The new enabled state of the output.
+     * \param grab Whether to grab the X display.
+     * \return Whether this output was successfully changed.
+     */
+    bool changeOutput(QOutput* output, bool enable, bool grab);
+    /*!
+     * \brief Change the given output state asynchronously
+     *
+     * Record the new output state if a transaction is in progress,
+     * otherwise apply it asynchronously.
+     * \param output The output to change.
+     * \param enable The new enabled state of the output.
+     * \param callback The function called with the result of the operation.
+     * \param grab Whether to grab the X display.
+     */
+    void changeOutputAsync(QOutput* output, bool enable, const QOperationCallback& callback, bool grab);
+    /*!
+     * \brief Filter output changes
+     *
+     * Drop the changes which do not modify the output state.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * \param effectiveChanges Filled with the changes which modify the output state.
+     * \return Whether all the outputs in the change set exist.
+     */
+    bool filterChanges(const QOutputChanges& changes, QOutputChanges* effectiveChanges) const;
+    /*!
+     * \brief Compile a profile
+     *
+     * Compute the target state of each connected output for the given profile,
+     * or get it from the cache.
+     * \param name The name of the profile.
+     * \param plan Filled with the target state of each connected output.
+     * \return Whether the profile exists.
+     */
+    bool compileProfile(const QString& name, QOutputChanges* plan);
+
+    QHash<QString, QOutput*> mNameIndex;            /*!< The connected outputs by name */
+    QMap<QString, QOutputId> mTopology;             /*!< The identifiers of the connected outputs by name */
+    QHash<QString, QOutputChanges> mProfilePlans;   /*!< The compiled profiles by name */
+    QSet<QOutputId> mBlankedOutputs;                /*!< The identifiers of the blanked outputs */
+    std::function<void(void)> mChangeCallback;      /*!< The function called when the outputs change */
+    bool mTransaction;              /*!< Whether a transaction is in progress */
+    QOutputChanges mPendingChanges; /*!< The output changes recorded during the transaction */
+
+    static const int probeTimeout = 2000;                   /*!< The default timeout of backend probes (in ms) */
+    static const quint32 snapshotMagic = 0x534d4c53;        /*!< The magic number of snapshot files */
+    static const quint16 snapshotVersion = 1;               /*!< The version of the snapshot file format */
+
+    /*!
+     * \brief Backend
+     *
+     * Instances of this structure describe an available backend.
+     */
+    struct Backend {
+        QString name;                                               /*!< The name of the backend */
+        QByteArray traceName;                                       /*!< The name of the backend probe in traces */
+        std::function<QScreenResources*(bool)> create;              /*!< The synchronous factory of the backend */
+        std::function<void(bool, const QProbeCallback&)> probe;     /*!< The asynchronous factory of the backend (if any) */
+    };
+    /*!
+     * \brief Describe a backend
+     *
+     * Describe the given backend class. Its \c probe() function is used if it has one,
+     * otherwise its \c create() function is run in a thread to probe it (see createInThread()).
+     * \tparam T The backend class.
+     * \return The description of the backend.
+     */
+    template<typename T>
+    static Backend backend(void);
+    /*!
+     * \brief Probe backends
+     *
+     * Probe the given backends concurrently.
+     * \param backends The backends to probe, in priority order.
+     * \param timeout The timeout of the probes (in ms).
+     * \param winner If not \c nullptr, the probes stop as soon as the first usable backend
+     * in priority order is known, and it is returned in this pointer. Otherwise, all the probes are awaited.
+     * \return The probe results, in the same order as the backends.
+     */
+    static QList<BackendProbe> probe(const QList<Backend>& backends, int timeout, QScreenResources** winner);
+    /*!
+     * \brief Create screen resources in a thread
+     *
+     * Run the given synchronous factory in a new thread, so that a hung display server
+     * does not block the calling thread and the probe is bounded by the timeout.
+     * The screen resources are moved to the calling thread (see moveToThread()),
+     * and the callback is called in the calling thread, which must run an event loop.
+     * The callback is also called when the thread finishes after the probe timed out:
+     * it must then delete the screen resources (see probe()).
+     * The thread is deleted when it finishes; a thread blocked by a hung display server
+     * cannot be stopped and runs until the server replies.
+     * \param create The synchronous factory of the backend.
+     * \param callback The callback receiving the new screen resources, or \c nullptr.
+     */
+    static void createInThread(const std::function<QScreenResources*(bool)>& create, const QProbeCallback& callback);
+    /*!
+     * \brief Display key
+     *
+     * \return A key identifying the current session type and display (usable in file names).
+     */
+    static QString displayKey(void);
+    /*!
+     * \brief Backend cache key
+     *
+     * \return The key of the cached backend for the current session type and display.
+     */
+    static QString backendCacheKey(void);
+
     /*! The list of available backends */
-    static QList< QPair< QString, std::function<QScreenResources*(bool)> > > availableBackends;
+    static QList<Backend> availableBackends;
     /*!
      * \brief Initialize available backends.
      *
      * This function is in charge of initializing the list of available backends.
      */
     static void initBackends(void);
+
+    friend class QOutput;
 };
 
 #endif // QSCREENRESOURCES_H
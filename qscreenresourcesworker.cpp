@@ -0,0 +1,159 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "qscreenresourcesworker.h"
+#include "qoutput.h"
+
+#include <QtDebug>
+
+QScreenResourcesWorker::QScreenResourcesWorker(void)
+    : mResources(nullptr), mCanBlank(false), mRunning(false)
+{
+    mThread.setObjectName("backend");
+    mContext = new QObject();
+    mContext->moveToThread(&mThread);
+}
+
+QScreenResourcesWorker::~QScreenResourcesWorker(void)
+{
+    // The queued commands are run before the screen resources are deleted:
+    if (mThread.isRunning()) {
+        QMetaObject::invokeMethod(mContext, [this] {
+            qDebug() << "Delete screen resources";
+            if (mResources != nullptr)
+                mResources->setChangeCallback(std::function<void(void)>());
+            delete mResources;
+            mResources = nullptr;
+        }, Qt::BlockingQueuedConnection);
+        mThread.quit();
+        mThread.wait();
+    }
+    delete mContext;
+}
+
+bool QScreenResourcesWorker::start(const QString& backend)
+{
+    if (mThread.isRunning())
+        return mResources != nullptr;
+
+    mThread.start();
+    return runAndWait([this, backend] (QScreenResources* resources) {
+        Q_UNUSED(resources);
+        mResources = QScreenResources::create(backend);
+        if (mResources == nullptr)
+            return false;
+        mBackendName = mResources->name;
+        mCanBlank = mResources->canBlank();
+
+        // The changes made by the commands are published with their results:
+        mResources->outputs();
+        mResources->setChangeCallback([this] {
+            if (!mRunning)
+                publish();
+        });
+        return true;
+    });
+}
+
+QScreenResourcesWorker::OutputState QScreenResourcesWorker::output(QOutputId outputId) const
+{
+    foreach (const OutputState& state, mOutputs) {
+        if (state.id == outputId)
+            return state;
+    }
+    return OutputState();
+}
+
+void QScreenResourcesWorker::run(const Command& command, const QOperationCallback& callback)
+{
+    QMetaObject::invokeMethod(mContext, [this, command, callback] {
+        mRunning = true;
+        bool ok = (mResources != nullptr) && command(mResources);
+        mRunning = false;
+        QList<OutputState> outputs = snapshot();
+
+        // The pending results are dropped when the worker is deleted:
+        QMetaObject::invokeMethod(&mReceiver, [this, ok, outputs, callback] {
+            update(outputs);
+            if (callback)
+                callback(ok);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+bool QScreenResourcesWorker::runAndWait(const Command& command)
+{
+    bool ok = false;
+    QList<OutputState> outputs;
+
+    QMetaObject::invokeMethod(mContext, [this, &command, &ok, &outputs] {
+        // The screen resources are created by the first command:
+        mRunning = true;
+        ok = command(mResources);
+        mRunning = false;
+        outputs = snapshot();
+    }, Qt::BlockingQueuedConnection);
+
+    update(outputs);
+    return ok;
+}
+
+QList<QScreenResourcesWorker::OutputState> QScreenResourcesWorker::snapshot(void) const
+{
+    QList<OutputState> ans;
+
+    if (mResources == nullptr)
+        return ans;
+
+    // The outputs are not refreshed, so that the snapshot does not query the backend:
+    const QScreenResources* resources = mResources;
+    for (QOutput* output : resources->outputs()) {
+        if (output->connection != QOutput::Connection::Connected)
+            continue;
+
+        OutputState state;
+        state.id = output->id;
+        state.name = output->name;
+        state.display = output->display();
+        state.enabled = output->enabled();
+        state.blanked = output->blanked();
+        ans << state;
+    }
+
+    return ans;
+}
+
+void QScreenResourcesWorker::publish(void)
+{
+    QList<OutputState> outputs = snapshot();
+
+    // The pending snapshots are dropped when the worker is deleted:
+    QMetaObject::invokeMethod(&mReceiver, [this, outputs] {
+        update(outputs);
+    }, Qt::QueuedConnection);
+}
+
+void QScreenResourcesWorker::update(const QList<OutputState>& outputs)
+{
+    if (outputs == mOutputs)
+        return;
+
+    mOutputs = outputs;
+    if (mChangeCallback)
+        mChangeCallback();
+}
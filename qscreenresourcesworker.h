@@ -0,0 +1,203 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef QSCREENRESOURCESWORKER_H
+#define QSCREENRESOURCESWORKER_H
+
+#include "qscreenresources.h"
+
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QThread>
+
+/*!
+ * \brief Screen resources worker
+ *
+ * This class owns a screen resources instance living in a dedicated thread,
+ * so that the latency of the backend never blocks the user interface.
+ *
+ * The commands are queued to the backend thread and executed one at a time, in order.
+ * Their results are delivered to the thread which owns the worker through callbacks,
+ * along with a snapshot of the connected outputs, which can be read without
+ * accessing the screen resources. The snapshot is also updated when the backend
+ * notifies a change of the outputs (e.g. an output is connected or disconnected).
+ *
+ * Only the commands may access the screen resources instance.
+ */
+class QScreenResourcesWorker
+{
+public:
+    /*!
+     * \brief Output state
+     *
+     * Instances of this structure hold the state of a connected output
+     * when the last command finished.
+     */
+    struct OutputState {
+        QOutputId id = 0;       /*!< The output id (0 for an unknown output) */
+        QString name;           /*!< The output name */
+        QString display;        /*!< The display name of the output */
+        bool enabled = false;   /*!< Whether the output is enabled */
+        bool blanked = false;   /*!< Whether the output is blanked */
+
+        /*!
+         * \brief Equality operator
+         *
+         * \param other Another output state.
+         * \return Whether both output states are equal.
+         */
+        inline bool operator==(const OutputState& other) const {
+            return (id == other.id) && (name == other.name) && (display == other.display)
+                && (enabled == other.enabled) && (blanked == other.blanked);
+        }
+    };
+
+    /*!
+     * \brief Command
+     *
+     * A command is run in the backend thread with the screen resources.
+     * It returns whether it succeeded.
+     */
+    typedef std::function<bool(QScreenResources*)> Command;
+
+    /*!
+     * \brief Constructor
+     *
+     * Initialize a stopped worker.
+     * \sa start()
+     */
+    QScreenResourcesWorker(void);
+    /*!
+     * \brief Destructor
+     *
+     * Wait for the queued commands, delete the screen resources and stop the backend thread.
+     */
+    ~QScreenResourcesWorker(void);
+
+    /*!
+     * \brief Start the worker
+     *
+     * Start the backend thread and create the screen resources in it.
+     * This function waits for the screen resources to be created.
+     * \param backend The backend to use (or an empty string to use the prefered backend).
+     * \return Whether the screen resources could be created.
+     * \sa QScreenResources::create()
+     */
+    bool start(const QString& backend);
+
+    /*!
+     * \brief Backend name
+     *
+     * \return The name of the backend of the screen resources.
+     */
+    inline QString backendName(void) const {return mBackendName;}
+    /*!
+     * \brief Whether the backend can blank outputs
+     *
+     * \return Whether the backend can blank outputs.
+     * \sa QScreenResources::canBlank()
+     */
+    inline bool canBlank(void) const {return mCanBlank;}
+    /*!
+     * \brief Connected outputs
+     *
+     * Returns the state of the connected outputs when the last command finished.
+     * \return The state of the connected outputs.
+     */
+    inline const QList<OutputState>& outputs(void) const {return mOutputs;}
+    /*!
+     * \brief Connected output
+     *
+     * Returns the state of the given connected output when the last command finished.
+     * \param outputId The id of the output.
+     * \return The state of the output (its id is 0 if the output is not connected).
+     */
+    OutputState output(QOutputId outputId) const;
+    /*!
+     * \brief Set the change callback
+     *
+     * Set the function called in the thread owning the worker
+     * whenever the state of the connected outputs changes.
+     * \param callback The function called when the outputs change.
+     * \sa outputs()
+     */
+    inline void setChangeCallback(const std::function<void(void)>& callback) {mChangeCallback = callback;}
+
+    /*!
+     * \brief Run a command
+     *
+     * Queue the given command to the backend thread and return immediately.
+     * When the command finishes, the output states are updated and the callback
+     * is called in the thread owning the worker.
+     * \param command The command to run.
+     * \param callback The callback receiving whether the command succeeded.
+     * \sa runAndWait()
+     */
+    void run(const Command& command, const QOperationCallback& callback = QOperationCallback());
+    /*!
+     * \brief Run a command and wait
+     *
+     * Queue the given command to the backend thread and wait for it to finish.
+     * The output states are updated when this function returns.
+     * This should only be used at startup and exit.
+     * \param command The command to run.
+     * \return Whether the command succeeded.
+     * \sa run()
+     */
+    bool runAndWait(const Command& command);
+private:
+    Q_DISABLE_COPY(QScreenResourcesWorker)
+
+    /*!
+     * \brief Snapshot the connected outputs
+     *
+     * Snapshot the state of the connected outputs.
+     * This function must be called in the backend thread.
+     * \return The state of the connected outputs.
+     */
+    QList<OutputState> snapshot(void) const;
+    /*!
+     * \brief Publish the output states
+     *
+     * Send a snapshot of the connected outputs to the thread owning the worker.
+     * This function must be called in the backend thread.
+     * \sa update()
+     */
+    void publish(void);
+    /*!
+     * \brief Update the output states
+     *
+     * Update the state of the connected outputs and call the change callback if they changed.
+     * This function must be called in the thread owning the worker.
+     * \param outputs The new state of the connected outputs.
+     */
+    void update(const QList<OutputState>& outputs);
+
+    QThread mThread;                /*!< The backend thread */
+    QObject* mContext;              /*!< Runs the commands in the backend thread */
+    QObject mReceiver;              /*!< Receives the results in the thread owning the worker */
+    QScreenResources* mResources;   /*!< The screen resources (only accessed in the backend thread) */
+    QString mBackendName;           /*!< The name of the backend */
+    bool mCanBlank;                 /*!< Whether the backend can blank outputs */
+    bool mRunning;                  /*!< Whether a command is running (only accessed in the backend thread) */
+    QList<OutputState> mOutputs;    /*!< The state of the connected outputs */
+    std::function<void(void)> mChangeCallback;  /*!< The function called when the outputs change */
+};
+
+#endif // QSCREENRESOURCESWORKER_H
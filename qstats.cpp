@@ -0,0 +1,170 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "qstats.h"
+
+#include <QMutexLocker>
+
+std::atomic<bool> QStats::enabled(false);
+QMutex QStats::mutex;
+QMap<QString, QStats::Counter> QStats::operations;
+QMap<QString, QMap<QString, QStats::Counter>> QStats::requests;
+QMap<QString, QStats::Gauge> QStats::gauges;
+thread_local QString QStats::current;
+
+void QStats::setEnabled(bool enabled)
+{
+    QStats::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void QStats::count(const QString& request, qint64 duration)
+{
+    if (!isEnabled())
+        return;
+
+    count(currentOperation(), request, duration);
+}
+
+void QStats::count(const QString& operation, const QString& request, qint64 duration)
+{
+    if (!isEnabled())
+        return;
+
+    QMutexLocker locker(&mutex);
+    Counter& counter = requests[operation][request];
+    counter.count++;
+    if (duration >= 0) {
+        counter.time += duration;
+        counter.max = qMax(counter.max, duration);
+        counter.timed = true;
+    }
+}
+
+void QStats::gauge(const QString& name, qint64 value)
+{
+    if (!isEnabled())
+        return;
+
+    QMutexLocker locker(&mutex);
+    if (!gauges.contains(name))
+        gauges[name].initial = value;
+    gauges[name].current = value;
+}
+
+QString QStats::currentOperation(void)
+{
+    return current.isEmpty() ? QString("other") : current;
+}
+
+qint64 QStats::maxDuration(const QString& request)
+{
+    QMutexLocker locker(&mutex);
+    qint64 ans = -1;
+
+    foreach (QString operation, requests.keys()) {
+        const Counter counter = requests.value(operation).value(request);
+        if (counter.timed)
+            ans = qMax(ans, counter.max);
+    }
+
+    return ans;
+}
+
+quint64 QStats::requestCount(void)
+{
+    QMutexLocker locker(&mutex);
+    quint64 ans = 0;
+
+    foreach (QString operation, requests.keys()) {
+        foreach (const Counter& counter, requests.value(operation))
+            ans += counter.count;
+    }
+
+    return ans;
+}
+
+QStringList QStats::report(void)
+{
+    QMutexLocker locker(&mutex);
+    QStringList lines;
+
+    QStringList names = operations.keys();
+    foreach (QString name, requests.keys()) {
+        if (!names.contains(name))
+            names << name;
+    }
+    names.sort();
+
+    foreach (QString name, names) {
+        const Counter operation = operations.value(name);
+        const QMap<QString, Counter> operationRequests = requests.value(name);
+        if (operation.count > 0)
+            lines << QString("%1: %2 operations, %3 ms").arg(name).arg(operation.count).arg(operation.time / 1e6, 0, 'f', 3);
+        else
+            lines << QString("%1:").arg(name);
+
+        for (auto rIt = operationRequests.constBegin(); rIt != operationRequests.constEnd(); rIt++) {
+            QString line = QString("  %1: %2 requests").arg(rIt.key()).arg(rIt.value().count);
+            if (operation.count > 0)
+                line += QString(" (%1 per operation)").arg((double) rIt.value().count / operation.count, 0, 'f', 1);
+            if (rIt.value().timed)
+                line += QString(", %1 ms (max %2 ms)").arg(rIt.value().time / 1e6, 0, 'f', 3).arg(rIt.value().max / 1e6, 0, 'f', 3);
+            lines << line;
+        }
+    }
+
+    for (auto gIt = gauges.constBegin(); gIt != gauges.constEnd(); gIt++) {
+        lines << QString("%1: %2 (initially %3, %4%5)").arg(gIt.key()).arg(gIt.value().current).arg(gIt.value().initial)
+                                                      .arg(gIt.value().current >= gIt.value().initial ? "+" : "")
+                                                      .arg(gIt.value().current - gIt.value().initial);
+    }
+
+    return lines;
+}
+
+void QStats::reset(void)
+{
+    QMutexLocker locker(&mutex);
+    operations.clear();
+    requests.clear();
+    for (auto gIt = gauges.begin(); gIt != gauges.end(); gIt++)
+        gIt.value().initial = gIt.value().current;
+}
+
+QStatsOperation::QStatsOperation(const QString& name)
+    : mOutermost(QStats::isEnabled() && QStats::current.isEmpty())
+{
+    if (!mOutermost)
+        return;
+
+    QStats::current = name;
+    mTimer.start();
+}
+
+QStatsOperation::~QStatsOperation(void)
+{
+    if (!mOutermost)
+        return;
+
+    QMutexLocker locker(&QStats::mutex);
+    QStats::Counter& counter = QStats::operations[QStats::current];
+    counter.count++;
+    counter.time += mTimer.nsecsElapsed();
+    counter.timed = true;
+    QStats::current.clear();
+}
@@ -0,0 +1,190 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef QSTATS_H
+#define QSTATS_H
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+
+#include <atomic>
+
+/*!
+ * \brief Request statistics
+ *
+ * This class counts the requests sent by the backends (X requests, KScreen operations, ...)
+ * and aggregates them per high-level operation (refresh, enable, disable, restore, ...).
+ *
+ * The current operation is set with QStatsOperation instances. The outermost one wins,
+ * so that e.g. the refresh done while enabling an output is accounted to the enable operation.
+ * The requests sent outside of any operation are accounted to the \c other operation.
+ * The duration of an operation only includes its synchronous part.
+ *
+ * Nothing is collected until statistics are enabled, so that counting requests
+ * costs a single atomic load when they are not requested.
+ * \sa QStatsOperation
+ */
+class QStats
+{
+public:
+    /*!
+     * \brief Enable statistics
+     *
+     * Start or stop collecting statistics.
+     * \param enabled Whether statistics should be collected.
+     * \sa isEnabled()
+     */
+    static void setEnabled(bool enabled);
+    /*!
+     * \brief Statistics enabled
+     *
+     * \return Whether statistics are collected.
+     * \sa setEnabled()
+     */
+    static inline bool isEnabled(void) {return enabled.load(std::memory_order_relaxed);}
+    /*!
+     * \brief Count a request
+     *
+     * Count a request in the current operation.
+     * \param request The name of the request.
+     * \param duration The duration of the request (in ns), or -1 if it is not measured.
+     */
+    static void count(const QString& request, qint64 duration = -1);
+    /*!
+     * \brief Count a request
+     *
+     * Count a request in the given operation.
+     * This is used by asynchronous requests which finish after the operation.
+     * \param operation The name of the operation.
+     * \param request The name of the request.
+     * \param duration The duration of the request (in ns), or -1 if it is not measured.
+     * \sa currentOperation()
+     */
+    static void count(const QString& operation, const QString& request, qint64 duration);
+    /*!
+     * \brief Set a gauge
+     *
+     * Set the value of a gauge (e.g. the size of a server resource).
+     * The first value is kept, so that the report shows the difference.
+     * \param name The name of the gauge.
+     * \param value The new value of the gauge.
+     */
+    static void gauge(const QString& name, qint64 value);
+    /*!
+     * \brief Current operation
+     *
+     * \return The name of the current operation of the calling thread.
+     */
+    static QString currentOperation(void);
+    /*!
+     * \brief Maximum duration of a request
+     *
+     * \param request The name of the request.
+     * \return The maximum duration of the given request (in ns) in all the operations,
+     * or -1 if it is not measured.
+     */
+    static qint64 maxDuration(const QString& request);
+    /*!
+     * \brief Number of requests
+     *
+     * \return The total number of requests counted since the last reset, in all the operations.
+     * \sa reset()
+     */
+    static quint64 requestCount(void);
+    /*!
+     * \brief Statistics report
+     *
+     * For each operation, the report gives the number of times it was done,
+     * and the number of requests of each kind (total and per operation),
+     * with their total and maximum duration when it is measured.
+     * It ends with the initial and current value of the gauges.
+     * \return The lines of the report.
+     */
+    static QStringList report(void);
+    /*!
+     * \brief Reset statistics
+     *
+     * Reset all the counters. The gauges restart from their current value.
+     */
+    static void reset(void);
+private:
+    friend class QStatsOperation;
+
+    /*!
+     * \brief Counter
+     *
+     * Instances of this structure count operations or requests.
+     */
+    struct Counter {
+        quint64 count = 0;  /*!< The number of operations or requests */
+        qint64 time = 0;    /*!< The total duration (in ns) */
+        qint64 max = 0;     /*!< The maximum duration (in ns) */
+        bool timed = false; /*!< Whether the duration is measured */
+    };
+
+    /*!
+     * \brief Gauge
+     *
+     * Instances of this structure hold the value of a gauge.
+     */
+    struct Gauge {
+        qint64 initial = 0; /*!< The first value */
+        qint64 current = 0; /*!< The last value */
+    };
+
+    static std::atomic<bool> enabled;                       /*!< Whether statistics are collected */
+    static QMutex mutex;                                    /*!< Protects the counters */
+    static QMap<QString, Counter> operations;               /*!< The operation counters */
+    static QMap<QString, QMap<QString, Counter>> requests;  /*!< The request counters of each operation */
+    static QMap<QString, Gauge> gauges;                     /*!< The gauges */
+    static thread_local QString current;                    /*!< The current operation of the thread */
+};
+
+/*!
+ * \brief Operation accounting scope
+ *
+ * Instances of this class set the current operation of QStats for their lifetime,
+ * unless an operation is already in progress.
+ * \sa QStats
+ */
+class QStatsOperation
+{
+public:
+    /*!
+     * \brief Constructor
+     *
+     * Start an operation, unless an operation is already in progress.
+     * \param name The name of the operation.
+     */
+    QStatsOperation(const QString& name);
+    /*!
+     * \brief Destructor
+     *
+     * End the operation.
+     */
+    ~QStatsOperation(void);
+private:
+    Q_DISABLE_COPY(QStatsOperation)
+
+    bool mOutermost;        /*!< Whether this is the outermost operation */
+    QElapsedTimer mTimer;   /*!< Measures the duration of the operation */
+};
+
+#endif // QSTATS_H
@@ -0,0 +1,111 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "qtracer.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThread>
+#include <QtDebug>
+
+#include <chrono>
+
+std::atomic<bool> QTracer::enabled(false);
+std::atomic<quint64> QTracer::next(0);
+QTracer::Event* QTracer::events = nullptr;
+int QTracer::capacity = 0;
+QString QTracer::fileName;
+
+void QTracer::start(const QString& fileName, int capacity)
+{
+    if ((events != nullptr) || (capacity <= 0))
+        return;
+
+    QTracer::events = new Event[capacity];
+    for (int e = 0; e < capacity; e++)
+        QTracer::events[e].sequence.store(0, std::memory_order_relaxed);
+    QTracer::capacity = capacity;
+    QTracer::fileName = fileName;
+    QTracer::next.store(0, std::memory_order_relaxed);
+    QTracer::enabled.store(true, std::memory_order_release);
+}
+
+qint64 QTracer::now(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void QTracer::record(const char* name, qint64 begin, qint64 end)
+{
+    if (!isEnabled())
+        return;
+
+    quint64 index = next.fetch_add(1, std::memory_order_relaxed);
+    Event& event = events[index % capacity];
+    event.sequence.store(0, std::memory_order_relaxed);
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    event.sequence.store(index + 1, std::memory_order_release);
+}
+
+void QTracer::stop(void)
+{
+    if (!enabled.exchange(false, std::memory_order_acq_rel))
+        return;
+
+    // Convert the completely written events (oldest first):
+    QJsonArray traceEvents;
+    quint64 last = next.load(std::memory_order_acquire);
+    quint64 first = (last > (quint64) capacity) ? last - capacity : 0;
+    qint64 pid = QCoreApplication::applicationPid();
+    for (quint64 index = first; index < last; index++) {
+        const Event& event = events[index % capacity];
+        if (event.sequence.load(std::memory_order_acquire) != index + 1)
+            continue;
+
+        QJsonObject traceEvent;
+        traceEvent.insert("name", QString::fromLatin1(event.name));
+        traceEvent.insert("cat", "shutdownmonitor");
+        traceEvent.insert("ph", "X");
+        traceEvent.insert("ts", event.begin / 1000.0);
+        traceEvent.insert("dur", (event.end - event.begin) / 1000.0);
+        traceEvent.insert("pid", pid);
+        traceEvent.insert("tid", (qint64) event.thread);
+        traceEvents.append(traceEvent);
+    }
+    // The ring buffer is not freed, since other threads may still be recording into it.
+
+    // Save the trace:
+    QJsonObject trace;
+    trace.insert("traceEvents", traceEvents);
+    trace.insert("displayTimeUnit", "ns");
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << QObject::tr("Could not open trace file: %1").arg(fileName) << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    if (!file.commit())
+        qWarning() << QObject::tr("Could not write trace file: %1").arg(fileName) << file.errorString();
+}
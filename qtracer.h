@@ -0,0 +1,137 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef QTRACER_H
+#define QTRACER_H
+
+#include <QString>
+
+#include <atomic>
+
+/*!
+ * \brief Phase tracer
+ *
+ * This class records the begin and end timestamps (in nanoseconds) of the traced phases
+ * in a fixed-size ring buffer and saves them in the trace event JSON format
+ * (which can be opened in \c chrome://tracing or Perfetto).
+ *
+ * Recording is lock-free: each event claims a slot with an atomic increment,
+ * and the oldest events are overwritten when the buffer is full.
+ * When tracing is off, a traced phase only costs a relaxed atomic load.
+ * \sa QTraceScope
+ */
+class QTracer
+{
+public:
+    /*!
+     * \brief Whether tracing is enabled
+     *
+     * \return \c true when tracing has been started.
+     */
+    inline static bool isEnabled(void) {return enabled.load(std::memory_order_relaxed);}
+    /*!
+     * \brief Start tracing
+     *
+     * Allocate the ring buffer and start recording the events.
+     * The events are saved in the given file by stop().
+     * Tracing can only be started once.
+     * \param fileName The name of the trace file.
+     * \param capacity The maximum number of recorded events.
+     */
+    static void start(const QString& fileName, int capacity = defaultCapacity);
+    /*!
+     * \brief Stop tracing
+     *
+     * Stop recording the events and save them in the trace file.
+     * Does nothing if tracing is not enabled.
+     */
+    static void stop(void);
+    /*!
+     * \brief Current timestamp
+     *
+     * \return The current value of the monotonic clock (in nanoseconds).
+     */
+    static qint64 now(void);
+    /*!
+     * \brief Record an event
+     *
+     * Record a complete event with the given name and timestamps.
+     * \param name The name of the event (it must outlive the tracer).
+     * \param begin The begin timestamp (in nanoseconds).
+     * \param end The end timestamp (in nanoseconds).
+     * \sa now()
+     */
+    static void record(const char* name, qint64 begin, qint64 end);
+private:
+    static const int defaultCapacity = 65536;   /*!< The default capacity of the ring buffer */
+
+    /*!
+     * \brief Trace event
+     *
+     * Instances of this structure are the slots of the ring buffer.
+     */
+    struct Event {
+        std::atomic<quint64> sequence;  /*!< The index of the event plus one, once it is completely written */
+        const char* name;               /*!< The name of the event */
+        qint64 begin;                   /*!< The begin timestamp (in nanoseconds) */
+        qint64 end;                     /*!< The end timestamp (in nanoseconds) */
+        quint64 thread;                 /*!< The identifier of the recording thread */
+    };
+
+    static std::atomic<bool> enabled;   /*!< Whether tracing is enabled */
+    static std::atomic<quint64> next;   /*!< The index of the next event */
+    static Event* events;               /*!< The ring buffer */
+    static int capacity;                /*!< The capacity of the ring buffer */
+    static QString fileName;            /*!< The name of the trace file */
+};
+
+/*!
+ * \brief Traced scope
+ *
+ * Instances of this class record an event spanning their lifetime
+ * when tracing is enabled.
+ * \sa QTracer
+ */
+class QTraceScope
+{
+public:
+    /*!
+     * \brief Constructor
+     *
+     * Start a traced phase.
+     * \param name The name of the phase (it must outlive the tracer), or \c nullptr not to trace anything.
+     */
+    inline QTraceScope(const char* name)
+        : mName(QTracer::isEnabled() ? name : nullptr), mBegin(mName != nullptr ? QTracer::now() : 0) {}
+    /*!
+     * \brief Destructor
+     *
+     * End the traced phase.
+     */
+    inline ~QTraceScope(void) {
+        if (mName != nullptr)
+            QTracer::record(mName, mBegin, QTracer::now());
+    }
+private:
+    Q_DISABLE_COPY(QTraceScope)
+
+    const char* mName;  /*!< The name of the phase, or \c nullptr when it is not traced */
+    qint64 mBegin;      /*!< The begin timestamp (in nanoseconds) */
+};
+
+#endif // QTRACER_H
@@ -0,0 +1,277 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "qtraymenu.h"
+
+#include <QAction>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QSet>
+
+#include <QtDebug>
+
+QTrayMenu::QTrayMenu(QScreenResourcesWorker* worker, QWidget* parent)
+    : QMenu(parent), mWorker(worker), mBlankMenu(nullptr), mApplying(false)
+{
+    mQuietTimer.setSingleShot(true);
+    mQuietTimer.setInterval(defaultQuietPeriod);
+    QObject::connect(&mQuietTimer, &QTimer::timeout, [this] {
+        applyPendingChanges();
+    });
+
+    // The output actions are inserted before the separator:
+    mOutputSeparator = addSeparator();
+    updateOutputs();
+    mWorker->setChangeCallback([this] {
+        updateOutputs();
+    });
+}
+
+QTrayMenu::~QTrayMenu(void)
+{
+    mWorker->setChangeCallback(std::function<void(void)>());
+}
+
+QMenu* QTrayMenu::addBlankMenu(const QIcon& icon, const QString& title)
+{
+    if (mBlankMenu == nullptr) {
+        mBlankMenu = addMenu(icon, title);
+        updateOutputs();
+    }
+    return mBlankMenu;
+}
+
+void QTrayMenu::updateOutputs(void)
+{
+    QList<QScreenResourcesWorker::OutputState> outputs = mWorker->outputs();
+    QSet<QOutputId> outputIds;
+    foreach (QScreenResourcesWorker::OutputState output, outputs)
+        outputIds.insert(output.id);
+
+    // Remove the actions of the disconnected outputs (their changes are dropped):
+    foreach (QOutputId outputId, mOutputActions.keys()) {
+        if (outputIds.contains(outputId))
+            continue;
+        delete mOutputActions.take(outputId);
+        delete mBlankActions.take(outputId);
+        mLetters.remove(outputId);
+        mPendingChanges.remove(outputId);
+    }
+
+    // Add the actions of the new outputs in order, and relabel the other ones:
+    assignLetters(outputs);
+    QAction* next = mOutputSeparator;
+    QAction* nextBlank = nullptr;
+    for (int o = outputs.size() - 1; o >= 0; o--) {
+        const QScreenResourcesWorker::OutputState& output = outputs.at(o);
+
+        QAction* action = mOutputActions.value(output.id, nullptr);
+        if (action == nullptr) {
+            action = new QAction(this);
+            action->setData(QVariant::fromValue<QOutputId>(output.id));
+            QObject::connect(action, &QAction::triggered, [this, action] {
+                toggleOutput(action);
+            });
+            insertAction(next, action);
+            mOutputActions.insert(output.id, action);
+        }
+        QChar letter = mLetters.value(output.id);
+        QString text = letter.isNull() ? QString("     %1").arg(output.display)
+                                       : QString("%1. %2").arg(letter).arg(output.display);
+        if (action->text() != text)
+            action->setText(text);
+        action->setIcon(state(output.id) ? mEnabledIcon : mDisabledIcon);
+        next = action;
+
+        if (mBlankMenu == nullptr)
+            continue;
+        QAction* blankAction = mBlankActions.value(output.id, nullptr);
+        if (blankAction == nullptr) {
+            blankAction = new QAction(mBlankMenu);
+            blankAction->setCheckable(true);
+            blankAction->setData(QVariant::fromValue<QOutputId>(output.id));
+            QObject::connect(blankAction, &QAction::triggered, [this, blankAction] (bool blanked) {
+                blankOutput(blankAction, blanked);
+            });
+            mBlankMenu->insertAction(nextBlank, blankAction);
+            mBlankActions.insert(output.id, blankAction);
+        }
+        if (blankAction->text() != output.display)
+            blankAction->setText(output.display);
+        blankAction->setChecked(output.blanked);
+        nextBlank = blankAction;
+    }
+}
+
+void QTrayMenu::assignLetters(const QList<QScreenResourcesWorker::OutputState>& outputs)
+{
+    QSet<QChar> usedLetters;
+    foreach (QChar letter, mLetters)
+        usedLetters.insert(letter);
+
+    foreach (QScreenResourcesWorker::OutputState output, outputs) {
+        if (mLetters.contains(output.id))
+            continue;
+
+        // Prefer the former letter of the output, then the first free letter:
+        QChar letter = mFormerLetters.value(output.name);
+        if (letter.isNull() || usedLetters.contains(letter)) {
+            letter = QChar();
+            for (int l = 0; (l < letterCount) && letter.isNull(); l++) {
+                if (!usedLetters.contains(QChar('A' + l)))
+                    letter = QChar('A' + l);
+            }
+        }
+        if (!letter.isNull()) {
+            usedLetters.insert(letter);
+            mFormerLetters.insert(output.name, letter);
+        }
+        mLetters.insert(output.id, letter);
+    }
+}
+
+void QTrayMenu::setIcons(const QIcon& enabledIcon, const QIcon& disabledIcon)
+{
+    mEnabledIcon = enabledIcon;
+    mDisabledIcon = disabledIcon;
+    updateIcons();
+}
+
+void QTrayMenu::updateIcons(void)
+{
+    for (auto it = mOutputActions.constBegin(); it != mOutputActions.constEnd(); it++)
+        it.value()->setIcon(state(it.key()) ? mEnabledIcon : mDisabledIcon);
+}
+
+bool QTrayMenu::isOutputAction(QAction* action) const
+{
+    return mOutputActions.value(action->data().value<QOutputId>(), nullptr) == action;
+}
+
+bool QTrayMenu::appliedState(QOutputId outputId) const
+{
+    return mApplyingChanges.value(outputId, mWorker->output(outputId).enabled);
+}
+
+bool QTrayMenu::state(QOutputId outputId) const
+{
+    return mPendingChanges.value(outputId, appliedState(outputId));
+}
+
+void QTrayMenu::toggleOutput(QAction* action)
+{
+    QOutputId outputId = action->data().value<QOutputId>();
+    if (mWorker->output(outputId).id == 0)
+        return;
+
+    // Only keep the net change (toggling twice does nothing):
+    bool enabled = !state(outputId);
+    if (enabled == appliedState(outputId))
+        mPendingChanges.remove(outputId);
+    else
+        mPendingChanges.insert(outputId, enabled);
+
+    // Update the icon optimistically and wait for the next click:
+    action->setIcon(enabled ? mEnabledIcon : mDisabledIcon);
+    mQuietTimer.start();
+}
+
+void QTrayMenu::blankOutput(QAction* action, bool blanked)
+{
+    QOutputId outputId = action->data().value<QOutputId>();
+    mWorker->run([outputId, blanked] (QScreenResources* resources) {
+        QOutput* output = resources->output(outputId);
+        return (output != nullptr) && resources->blankOutput(output, blanked);
+    }, [this, outputId] (bool ok) {
+        if (!ok)
+            qWarning() << QObject::tr("Could not blank or unblank the output");
+
+        // The action may have been removed in the meantime:
+        QAction* blankAction = mBlankActions.value(outputId, nullptr);
+        if (blankAction != nullptr)
+            blankAction->setChecked(mWorker->output(outputId).blanked);
+    });
+}
+
+void QTrayMenu::applyPendingChanges(void)
+{
+    mQuietTimer.stop();
+
+    // The changes are applied when the reconfiguration in progress finishes:
+    if (mApplying || mPendingChanges.isEmpty())
+        return;
+
+    mApplyingChanges = mPendingChanges;
+    mPendingChanges.clear();
+    mApplying = true;
+    QOutputChanges changes = mApplyingChanges;
+    mWorker->run([changes] (QScreenResources* resources) {
+        return resources->applyChanges(changes);
+    }, [this] (bool ok) {
+        if (!ok)
+            qWarning() << QObject::tr("Could not apply the output changes");
+
+        // Roll the icons back to the output states on failure:
+        mApplying = false;
+        mApplyingChanges.clear();
+        updateIcons();
+
+        // Apply the changes recorded in the meantime:
+        if (mPendingChanges.isEmpty())
+            return;
+        if (isVisible())
+            mQuietTimer.start();
+        else
+            applyPendingChanges();
+    });
+}
+
+void QTrayMenu::mouseReleaseEvent(QMouseEvent* event)
+{
+    // Keep the menu open, so that several outputs can be toggled:
+#if QT_VERSION >= 0x060000
+    QAction* action = actionAt(event->position().toPoint());
+#else // QT_VERSION
+    QAction* action = actionAt(event->pos());
+#endif // QT_VERSION
+    if ((action != nullptr) && action->isEnabled() && isOutputAction(action)) {
+        action->trigger();
+        return;
+    }
+
+    QMenu::mouseReleaseEvent(event);
+}
+
+void QTrayMenu::keyPressEvent(QKeyEvent* event)
+{
+    // Keep the menu open, so that several outputs can be toggled:
+    QAction* action = activeAction();
+    bool activate = (event->key() == Qt::Key_Return) || (event->key() == Qt::Key_Enter) || (event->key() == Qt::Key_Space);
+    if (activate && (action != nullptr) && action->isEnabled() && isOutputAction(action)) {
+        action->trigger();
+        return;
+    }
+
+    QMenu::keyPressEvent(event);
+}
+
+void QTrayMenu::hideEvent(QHideEvent* event)
+{
+    QMenu::hideEvent(event);
+    applyPendingChanges();
+}
@@ -0,0 +1,224 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef QTRAYMENU_H
+#define QTRAYMENU_H
+
+#include "qscreenresourcesworker.h"
+
+#include <QIcon>
+#include <QMap>
+#include <QMenu>
+#include <QTimer>
+
+class QAction;
+
+/*!
+ * \brief System tray menu
+ *
+ * This class is the context menu of the system tray icon.
+ * Clicking on an output action only records the new state of the output
+ * and updates its icon optimistically, and the menu stays open,
+ * so that several outputs can be toggled.
+ *
+ * The recorded changes are coalesced into one net change set, which is applied
+ * in a single reconfiguration after a quiet period without clicks, or when the menu is closed.
+ * When the reconfiguration fails, the icons are rolled back to the output states.
+ *
+ * The reconfigurations are run by a QScreenResourcesWorker, so that the menu stays responsive,
+ * and the icons reflect the output states of its last snapshot.
+ *
+ * The output actions are kept in sync with the connected outputs of the worker:
+ * when they change, only the affected actions are added, removed or relabelled,
+ * so that opening the menu never queries the backend. Each output keeps its letter
+ * while it is connected, and gets it back when it is connected again, if it is still free.
+ */
+class QTrayMenu : public QMenu
+{
+public:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize a menu with one action per connected output of the given worker,
+     * followed by a separator. The other actions are added after the separator.
+     * The menu is updated whenever the connected outputs of the worker change.
+     * \param worker The worker owning the screen resources.
+     * \param parent The parent widget.
+     */
+    QTrayMenu(QScreenResourcesWorker* worker, QWidget* parent = nullptr);
+    /*!
+     * \brief Destructor
+     *
+     * Stop following the changes of the connected outputs.
+     */
+    ~QTrayMenu(void);
+
+    /*!
+     * \brief Add the blank sub-menu
+     *
+     * Add a sub-menu with one checkable action per connected output, which blanks the output.
+     * It is kept in sync with the connected outputs, like the output actions.
+     * \param icon The icon of the sub-menu.
+     * \param title The title of the sub-menu.
+     * \return The new sub-menu.
+     */
+    QMenu* addBlankMenu(const QIcon& icon, const QString& title);
+    /*!
+     * \brief Update the output actions
+     *
+     * Update the output actions (and the blank actions) according to the connected outputs of the worker:
+     * the actions of the disconnected outputs are removed, the actions of the new outputs are added
+     * and the actions of the other outputs are relabelled if needed.
+     * This function does not query the backend.
+     */
+    void updateOutputs(void);
+    /*!
+     * \brief Set the output icons
+     *
+     * Set the icons of the enabled and disabled outputs and update the output actions.
+     * \param enabledIcon The icon of the enabled outputs.
+     * \param disabledIcon The icon of the disabled outputs.
+     * \sa updateIcons()
+     */
+    void setIcons(const QIcon& enabledIcon, const QIcon& disabledIcon);
+    /*!
+     * \brief Update the output icons
+     *
+     * Update the icons of the output actions,
+     * according to the output states and the changes which are not applied yet.
+     * \sa setIcons()
+     */
+    void updateIcons(void);
+
+    /*!
+     * \brief Quiet period
+     *
+     * Returns the time without clicks after which the recorded changes are applied.
+     * \return The quiet period (in ms).
+     * \sa setQuietPeriod()
+     */
+    inline int quietPeriod(void) const {return mQuietTimer.interval();}
+    /*!
+     * \brief Set the quiet period
+     *
+     * Set the time without clicks after which the recorded changes are applied.
+     * \param msec The quiet period (in ms).
+     * \sa quietPeriod()
+     */
+    inline void setQuietPeriod(int msec) {mQuietTimer.setInterval(msec);}
+
+    /*!
+     * \brief Apply the recorded changes
+     *
+     * Apply the recorded changes in a single reconfiguration, without waiting for the quiet period.
+     * When a reconfiguration is in progress, they are applied when it finishes.
+     */
+    void applyPendingChanges(void);
+protected:
+    /*!
+     * \brief Handle mouse button releases
+     *
+     * Trigger the output actions without closing the menu.
+     * \param event The mouse event.
+     */
+    void mouseReleaseEvent(QMouseEvent* event);
+    /*!
+     * \brief Handle key presses
+     *
+     * Trigger the output actions without closing the menu.
+     * \param event The key event.
+     */
+    void keyPressEvent(QKeyEvent* event);
+    /*!
+     * \brief Handle the menu closing
+     *
+     * Apply the recorded changes.
+     * \param event The hide event.
+     */
+    void hideEvent(QHideEvent* event);
+private:
+    /*!
+     * \brief Toggle an output
+     *
+     * Record the new state of the output of the given action, update its icon
+     * and restart the quiet period.
+     * \param action The output action.
+     */
+    void toggleOutput(QAction* action);
+    /*!
+     * \brief Blank an output
+     *
+     * Blank or unblank the output of the given blank action.
+     * The action is checked according to the output state when it is done.
+     * \param action The blank action.
+     * \param blanked Whether the output should be blanked.
+     */
+    void blankOutput(QAction* action, bool blanked);
+    /*!
+     * \brief Is an output action?
+     *
+     * \param action An action of the menu.
+     * \return Whether the given action is an output action.
+     */
+    bool isOutputAction(QAction* action) const;
+    /*!
+     * \brief Assign the letters
+     *
+     * Assign a letter to the new connected outputs. An output gets back its former letter
+     * if it is free, otherwise it gets the first free letter, if any.
+     * \param outputs The connected outputs.
+     */
+    void assignLetters(const QList<QScreenResourcesWorker::OutputState>& outputs);
+    /*!
+     * \brief Applied output state
+     *
+     * Returns the state of the given output once the reconfiguration in progress, if any, is done.
+     * \param outputId The id of the output.
+     * \return Whether the output is enabled.
+     * \sa state()
+     */
+    bool appliedState(QOutputId outputId) const;
+    /*!
+     * \brief Requested output state
+     *
+     * Returns the state of the given output once the recorded changes are applied.
+     * \param outputId The id of the output.
+     * \return Whether the output is enabled.
+     * \sa appliedState()
+     */
+    bool state(QOutputId outputId) const;
+
+    QScreenResourcesWorker* mWorker;    /*!< The worker owning the screen resources */
+    QMap<QOutputId, QAction*> mOutputActions;   /*!< The output actions by output id */
+    QMap<QOutputId, QAction*> mBlankActions;    /*!< The blank actions by output id */
+    QMap<QOutputId, QChar> mLetters;            /*!< The letters of the connected outputs (a null letter for none) */
+    QMap<QString, QChar> mFormerLetters;        /*!< The letters given to the outputs by name */
+    QAction* mOutputSeparator;          /*!< The separator after the output actions */
+    QMenu* mBlankMenu;                  /*!< The blank sub-menu (if any) */
+    QIcon mEnabledIcon;                 /*!< The icon of the enabled outputs */
+    QIcon mDisabledIcon;                /*!< The icon of the disabled outputs */
+    QTimer mQuietTimer;                 /*!< The timer of the quiet period */
+    QOutputChanges mPendingChanges;     /*!< The recorded changes, which are not applied yet */
+    QOutputChanges mApplyingChanges;    /*!< The changes of the reconfiguration in progress */
+    bool mApplying;                     /*!< Whether a reconfiguration is in progress */
+
+    static const int defaultQuietPeriod = 400;  /*!< The default quiet period (in ms) */
+    static const int letterCount = 'Q' - 'A';   /*!< The number of output letters */
+};
+
+#endif // QTRAYMENU_H
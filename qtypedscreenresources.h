@@ -0,0 +1,62 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef QTYPEDSCREENRESOURCES_H
+#define QTYPEDSCREENRESOURCES_H
+
+#include "qscreenresources.h"
+
+/*!
+ * \brief Screen resources with typed outputs
+ *
+ * This class template is the base class for backends.
+ * As the backend only stores its own output type,
+ * it gives access to the outputs with their actual type without RTTI.
+ * \tparam Output The output type of the backend.
+ * \tparam Base The base class of the backend (QScreenResources or a class derived from it).
+ */
+template<typename Output, typename Base = QScreenResources>
+class QTypedScreenResources : public Base
+{
+protected:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the class with the given backend name.
+     * \param name The backend name.
+     */
+    inline QTypedScreenResources(const QString& name) :
+        Base(name) {}
+
+    /*!
+     * \brief Get a typed output by its id
+     *
+     * \param outputId The desired output identifier.
+     * \return The output corresponding to the given identifier, or \c nullptr if there is not any.
+     */
+    inline Output* typedOutput(QOutputId outputId) const {return static_cast<Output*>(this->mOutputs.value(outputId));}
+    /*!
+     * \brief Get all typed outputs
+     *
+     * \note Do not refresh the output cache.
+     * \return A non-allocating view on all the outputs, sorted by identifier.
+     */
+    inline QOutputView<Output> typedOutputs(void) const {return this->mOutputs.template view<Output>();}
+};
+
+#endif // QTYPEDSCREENRESOURCES_H
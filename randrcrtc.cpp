@@ -0,0 +1,61 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "randrcrtc.h"
+
+#include <QtDebug>
+
+#include <xcb/randr.h>
+
+RandRCrtc::RandRCrtc(void)
+    : x(0), y(0), width(0), height(0), mode(XCB_NONE), rotation(XCB_RANDR_ROTATION_ROTATE_0)
+{
+    resetCurrent();
+}
+
+void RandRCrtc::resetCurrent(void)
+{
+    current.x = x;
+    current.y = y;
+    current.mode = mode;
+    current.rotation = rotation;
+    current.outputs = outputs;
+}
+
+bool RandRCrtc::Config::enabled(void) const
+{
+    return (mode != XCB_NONE) && !outputs.isEmpty();
+}
+
+bool RandRCrtc::Config::operator==(const Config& other) const
+{
+    if (!enabled() || !other.enabled())
+        return (enabled() == other.enabled());
+
+    return (x == other.x) && (y == other.y)
+        && (mode == other.mode) && (rotation == other.rotation)
+        && (outputs == other.outputs);
+}
+
+QString RandRCrtc::display(void) const
+{
+    return QString("%1x%2+%3+%4").arg(width)
+                                 .arg(height)
+                                 .arg(x)
+                                 .arg(y);
+}
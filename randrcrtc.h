@@ -0,0 +1,130 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef RANDRCRTC_H
+#define RANDRCRTC_H
+
+#include <QString>
+#include <QList>
+#include <QRect>
+#include <QVector>
+
+typedef uint32_t xcb_randr_mode_t;
+typedef uint32_t xcb_randr_output_t;
+
+/*!
+ * \brief Internal representation for RandR CRTC
+ *
+ * Instances of this class represent a CRTC (Cathode Ray Tube Controller),
+ * independently of the library used to query it (see XRandRCrtc and XcbCrtc).
+ * In particular, they give the position of the CRTC buffer in the screen.
+ * The public fields describe the original CRTC state, which is used to compute the layout,
+ * whereas RandRCrtc::current describes the state currently set on the server.
+ */
+class RandRCrtc
+{
+public:
+    /*!
+     * \brief CRTC configuration
+     *
+     * Instances of this structure hold the configuration of a CRTC,
+     * as it is set with \c xcb_randr_set_crtc_config().
+     * A CRTC without mode or without outputs is disabled.
+     */
+    struct Config {
+        int x;                                  /*!< The x coordinate of the top left point of the CRTC on the screen */
+        int y;                                  /*!< The y coordinate of the top left point of the CRTC on the screen */
+        xcb_randr_mode_t mode;                  /*!< The mode of the CRTC */
+        uint16_t rotation;                      /*!< The rotation of the CRTC */
+        QList<xcb_randr_output_t> outputs;      /*!< The list of the associated outputs */
+
+        /*!
+         * \brief Is enabled?
+         *
+         * Returns whether the CRTC is enabled with this configuration.
+         * \return Whether the CRTC is enabled.
+         */
+        bool enabled(void) const;
+        /*!
+         * \brief Equality operator
+         *
+         * Two configurations are equal if they would result in the same CRTC state.
+         * In particular, all the disabled configurations are equal.
+         * \param other The configuration to compare with.
+         * \return Whether the configurations are equal.
+         */
+        bool operator==(const Config& other) const;
+        /*!
+         * \brief Inequality operator
+         *
+         * \param other The configuration to compare with.
+         * \return Whether the configurations differ.
+         * \sa operator==()
+         */
+        inline bool operator!=(const Config& other) const {return !operator==(other);}
+    };
+
+    int x;                                  /*!< The x coordinate of the top left point of the CRTC on the screen */
+    int y;                                  /*!< The y coordinate of the top left point of the CRTC on the screen */
+    unsigned int width;                     /*!< The width of the CRTC */
+    unsigned int height;                    /*!< The height of the CRTC */
+    xcb_randr_mode_t mode;                  /*!< The mode of the CRTC */
+    uint16_t rotation;                      /*!< The rotation of the CRTC */
+    QList<xcb_randr_output_t> outputs;      /*!< The list of the associated outputs */
+    Config current;                         /*!< The configuration currently set on the server */
+    QVector<uint16_t> gamma;                /*!< The gamma ramp (red, green and blue) saved when the CRTC was blanked, empty otherwise */
+
+    /*!
+     * \brief Destructor
+     *
+     * Destroys the CRTC internal representation.
+     */
+    inline virtual ~RandRCrtc(void) {}
+
+    /*!
+     * \brief User-friendly name of this CRTC
+     *
+     * Returns a user-friendly name for the CRTC.
+     * \return A user-friendly name for the CRTC.
+     */
+    QString display(void) const;
+    /*!
+     * \brief CRTC rectangle
+     *
+     * Returns the rectangle that this CRTC spans on the screen.
+     * \return The rectange that this CRTC spans on the screen.
+     * \sa x, y, width, height
+     */
+    inline QRect rect(void) const {return QRect(x, y, width, height);}
+protected:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize a disabled CRTC.
+     * The backends fill the fields with the information they retrieved.
+     */
+    RandRCrtc(void);
+    /*!
+     * \brief Reset the current configuration
+     *
+     * Set the current configuration to the original CRTC state.
+     */
+    void resetCurrent(void);
+};
+
+#endif // RANDRCRTC_H
@@ -0,0 +1,45 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "randroutput.h"
+#include "randrcrtc.h"
+#include "randrscreenresources.h"
+
+#include <QtDebug>
+
+#include <xcb/xcb.h>
+
+RandROutput::RandROutput(RandRScreenResources *parent)
+    : QOutput(parent), mCrtcId(XCB_NONE)
+{}
+
+RandRCrtc* RandROutput::crtc(void) const
+{
+    // Outputs are only created by their backend:
+    RandRScreenResources* parent = static_cast<RandRScreenResources*>(mParent);
+    return mCrtcId != XCB_NONE ? parent->crtc(mCrtcId): nullptr;
+}
+
+QString RandROutput::display(void) const
+{
+    if (name.isNull() || (crtc() == nullptr))
+        return name;
+
+    return QString("%1 (%2)").arg(name)
+                             .arg(crtc()->display());
+}
@@ -0,0 +1,68 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef RANDROUTPUT_H
+#define RANDROUTPUT_H
+
+#include "qoutput.h"
+#include <QString>
+
+typedef uint32_t xcb_randr_crtc_t;
+
+class RandRScreenResources;
+class RandRCrtc;
+
+/*!
+ * \brief Internal representation for RandR output
+ *
+ * Instances of this class represent an output (monitor, ...),
+ * independently of the library used to query it (see XRandROutput and XcbOutput).
+ */
+class RandROutput : public QOutput
+{
+public:
+    /*!
+     * \brief Associated CRTC
+     *
+     * Returns the internal representation of the CRTC (Cathode Ray Tube controler)
+     * associated with this controller.
+     * \return The associated CRTC.
+     */
+    RandRCrtc* crtc(void) const;
+    /*!
+     * \brief User-friendly name of this output
+     *
+     * Returns a user-friendly name for the output.
+     * \return A user-friendly name for the output.
+     */
+    QString display(void) const;
+protected:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize an output without CRTC.
+     * \param parent The parent screen resources.
+     */
+    RandROutput(RandRScreenResources* parent);
+
+    xcb_randr_crtc_t mCrtcId;       /*!< The id of the associated CRTC */
+
+    friend class RandRScreenResources;
+};
+
+#endif // RANDROUTPUT_H
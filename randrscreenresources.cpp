@@ -0,0 +1,500 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "randrscreenresources.h"
+#include "qstats.h"
+#include "qtracer.h"
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QtDebug>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <xcb/xcb.h>
+#include <xcb/randr.h>
+
+RandRScreenResources::RandRScreenResources(const QString& name)
+    : QTypedScreenResources<RandROutput>(name), mConnection(nullptr), mRoot(XCB_NONE), mConfigTimestamp(XCB_CURRENT_TIME)
+{}
+
+RandRScreenResources::~RandRScreenResources(void)
+{
+    qDeleteAll(mCrtcs);
+}
+
+RandRCrtc* RandRScreenResources::crtc(xcb_randr_crtc_t crtcId)
+{
+    if (crtcId == XCB_NONE)
+        return nullptr;
+    if (!mCrtcs.contains(crtcId))
+        fetchCrtcs(QList<xcb_randr_crtc_t>() << crtcId);
+    return mCrtcs.value(crtcId, nullptr);
+}
+
+void RandRScreenResources::setResources(const QList<xcb_randr_crtc_t>& crtcIds, const QList<xcb_randr_output_t>& outputIds, const QHash<xcb_randr_mode_t, QSize>& modeSizes, xcb_timestamp_t configTimestamp)
+{
+    mCrtcIds = crtcIds;
+    mOutputIds = outputIds;
+    mModeSizes = modeSizes;
+    mConfigTimestamp = configTimestamp;
+}
+
+void RandRScreenResources::initScreenSize(const QSize& size, const QSize& sizeMM, const QSize& minSize, const QSize& maxSize)
+{
+    mScreenSize = size;
+    mScreenSizeMM = sizeMM;
+    mMinScreenSize = minSize;
+    mMaxScreenSize = maxSize;
+    QStats::gauge("FramebufferBytes", 4ll * mScreenSize.width() * mScreenSize.height());
+}
+
+bool RandRScreenResources::apply(const QOutputChanges& changes, bool grab)
+{
+    QMap<RandROutput*, bool> oldOutputStates;
+    auto restoreOutputStates = [&oldOutputStates] {
+        for (auto it = oldOutputStates.constBegin(); it != oldOutputStates.constEnd(); it++)
+            it.key()->setEnabled(it.value());
+    };
+
+    // Update the output states:
+    for (auto it = changes.constBegin(); it != changes.constEnd(); it++) {
+        // Cast output to internal type:
+        RandROutput* rOutput = typedOutput(it.key());
+        // The output CRTC should be in the CRTC map:
+        if ((rOutput == nullptr) || !mCrtcs.contains(rOutput->mCrtcId)) {
+            restoreOutputStates();
+            return false;
+        }
+
+        oldOutputStates.insert(rOutput, rOutput->mEnabled);
+        rOutput->setEnabled(it.value());
+    }
+
+    // At least one output should remain enabled:
+    QRect totalScreen = mLayout.totalScreen();
+    QRect newScreen = mLayout.screen();
+    if (newScreen.isNull()) {
+        restoreOutputStates();
+        return false;
+    }
+
+    // Update only the CRTCs which change:
+    bool ans = setCrtcConfigs(planCrtcs(totalScreen, newScreen), grab);
+    if (!ans)
+        restoreOutputStates();
+    return ans;
+}
+
+void RandRScreenResources::writeSnapshot(QDataStream& stream) const
+{
+    stream << (quint32) mCrtcs.size();
+    for (auto it = mCrtcs.constBegin(); it != mCrtcs.constEnd(); it++) {
+        const RandRCrtc::Config& config = it.value()->current;
+        stream << (quint32) it.key() << (qint32) config.x << (qint32) config.y
+               << (quint32) config.mode << (quint16) config.rotation;
+        stream << (quint32) config.outputs.size();
+        foreach (xcb_randr_output_t outputId, config.outputs)
+            stream << (quint32) outputId;
+    }
+}
+
+bool RandRScreenResources::readSnapshot(QDataStream& stream)
+{
+    // Read the CRTC configurations:
+    QMap<xcb_randr_crtc_t, RandRCrtc::Config> configs;
+    quint32 crtcCount = 0;
+    stream >> crtcCount;
+    for (quint32 c = 0; (c < crtcCount) && (stream.status() == QDataStream::Ok); c++) {
+        quint32 crtcId, mode, outputCount;
+        qint32 x, y;
+        quint16 rotation;
+        stream >> crtcId >> x >> y >> mode >> rotation >> outputCount;
+
+        RandRCrtc::Config config;
+        config.x = x;
+        config.y = y;
+        config.mode = mode;
+        config.rotation = rotation;
+        for (quint32 o = 0; (o < outputCount) && (stream.status() == QDataStream::Ok); o++) {
+            quint32 outputId;
+            stream >> outputId;
+            config.outputs.append(outputId);
+        }
+        configs.insert(crtcId, config);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << QObject::tr("Invalid snapshot");
+        return false;
+    }
+
+    // The CRTCs disabled by a killed process may not be known yet:
+    QList<xcb_randr_crtc_t> missingCrtcIds;
+    for (auto it = configs.constBegin(); it != configs.constEnd(); it++) {
+        if (!mCrtcIds.contains(it.key())) {
+            qWarning() << QObject::tr("Unknown CRTC in snapshot: %1").arg(it.key());
+            return false;
+        }
+        if (!mCrtcs.contains(it.key()))
+            missingCrtcIds.append(it.key());
+    }
+    fetchCrtcs(missingCrtcIds);
+
+    // Apply the CRTC configurations which change in a single batch:
+    QMap<xcb_randr_crtc_t, RandRCrtc::Config> plan;
+    for (auto it = configs.constBegin(); it != configs.constEnd(); it++) {
+        RandRCrtc* crtc = mCrtcs.value(it.key(), nullptr);
+        if ((crtc == nullptr) || (it.value() != crtc->current))
+            plan.insert(it.key(), it.value());
+    }
+    bool ans = setCrtcConfigs(plan, true);
+
+    // Update the output states:
+    for (auto it = configs.constBegin(); it != configs.constEnd(); it++) {
+        foreach (xcb_randr_output_t outputId, it.value().outputs) {
+            RandROutput* rOutput = typedOutput(outputId);
+            if (rOutput != nullptr)
+                rOutput->mCrtcId = it.key();
+        }
+    }
+    for (RandROutput* rOutput : typedOutputs()) {
+        RandRCrtc* crtc = mCrtcs.value(rOutput->mCrtcId, nullptr);
+        rOutput->setEnabled((crtc != nullptr) && crtc->current.enabled() && crtc->current.outputs.contains(rOutput->id));
+    }
+
+    // The outputs blanked by a killed process are still dark:
+    resetZeroedGammas(configs.keys());
+    return ans;
+}
+
+bool RandRScreenResources::blank(QOutput* output, bool blanked)
+{
+    // The output CRTC should be in the CRTC map:
+    RandROutput* rOutput = typedOutput(output->id);
+    RandRCrtc* crtc = (rOutput != nullptr) ? mCrtcs.value(rOutput->mCrtcId, nullptr) : nullptr;
+    if (crtc == nullptr) {
+        qWarning() << QObject::tr("Output %1 does not have a known CRTC").arg(output->name);
+        return false;
+    }
+
+    // The gamma ramp is shared by the outputs of the CRTC:
+    for (RandROutput* o : typedOutputs()) {
+        if ((o != rOutput) && (o->mCrtcId == rOutput->mCrtcId) && o->blanked())
+            return true;
+    }
+
+    QTraceScope trace(blanked ? "blank" : "unblank");
+    QVector<uint16_t> ramp;
+    if (blanked) {
+        // Save the gamma ramp and zero it:
+        QStats::count("GetCrtcGamma");
+        xcb_randr_get_crtc_gamma_reply_t* reply = xcb_randr_get_crtc_gamma_reply(mConnection, xcb_randr_get_crtc_gamma(mConnection, rOutput->mCrtcId), nullptr);
+        if ((reply == nullptr) || (reply->size == 0)) {
+            qWarning() << QObject::tr("Could not get the gamma ramp of CRTC %1").arg(rOutput->mCrtcId);
+            free(reply);
+            return false;
+        }
+        crtc->gamma.resize(3 * reply->size);
+        std::copy(xcb_randr_get_crtc_gamma_red(reply), xcb_randr_get_crtc_gamma_red(reply) + reply->size, crtc->gamma.begin());
+        std::copy(xcb_randr_get_crtc_gamma_green(reply), xcb_randr_get_crtc_gamma_green(reply) + reply->size, crtc->gamma.begin() + reply->size);
+        std::copy(xcb_randr_get_crtc_gamma_blue(reply), xcb_randr_get_crtc_gamma_blue(reply) + reply->size, crtc->gamma.begin() + 2 * reply->size);
+        ramp.fill(0, 3 * reply->size);
+        free(reply);
+    } else {
+        // Restore the saved gamma ramp:
+        if (crtc->gamma.isEmpty()) {
+            qWarning() << QObject::tr("No saved gamma ramp for CRTC %1").arg(rOutput->mCrtcId);
+            return false;
+        }
+        ramp = crtc->gamma;
+        crtc->gamma.clear();
+    }
+
+    // A single request, which does not change the CRTC configuration:
+    int size = ramp.size() / 3;
+    QStats::count("SetCrtcGamma");
+    xcb_generic_error_t* error = xcb_request_check(mConnection, xcb_randr_set_crtc_gamma_checked(mConnection, rOutput->mCrtcId, size,
+                                                                                                 ramp.constData(), ramp.constData() + size, ramp.constData() + 2 * size));
+    if (error != nullptr) {
+        qWarning() << QObject::tr("Could not set the gamma ramp of CRTC %1. Error:").arg(rOutput->mCrtcId) << (int) error->error_code;
+        free(error);
+        // The CRTC keeps its previous gamma ramp:
+        if (blanked)
+            crtc->gamma.clear();
+        else
+            crtc->gamma = ramp;
+        return false;
+    }
+    return true;
+}
+
+void RandRScreenResources::resetZeroedGammas(const QList<xcb_randr_crtc_t>& crtcIds)
+{
+    // Send all the gamma ramp requests before waiting for any reply:
+    QVector<xcb_randr_get_crtc_gamma_cookie_t> cookies(crtcIds.size());
+    for (int c = 0; c < crtcIds.size(); c++) {
+        QStats::count("GetCrtcGamma");
+        cookies[c] = xcb_randr_get_crtc_gamma(mConnection, crtcIds.at(c));
+    }
+
+    bool changed = false;
+    for (int c = 0; c < crtcIds.size(); c++) {
+        xcb_randr_get_crtc_gamma_reply_t* reply = xcb_randr_get_crtc_gamma_reply(mConnection, cookies[c], nullptr);
+        if (reply == nullptr)
+            continue;
+
+        int size = reply->size;
+        bool zeroed = (size > 0);
+        for (int i = 0; zeroed && (i < size); i++)
+            zeroed = (xcb_randr_get_crtc_gamma_red(reply)[i] == 0) && (xcb_randr_get_crtc_gamma_green(reply)[i] == 0) && (xcb_randr_get_crtc_gamma_blue(reply)[i] == 0);
+        free(reply);
+        if (!zeroed)
+            continue;
+
+        QVector<uint16_t> ramp(size);
+        for (int i = 0; i < size; i++)
+            ramp[i] = size > 1 ? (65535ll * i) / (size - 1) : 65535;
+        QStats::count("SetCrtcGamma");
+        xcb_randr_set_crtc_gamma(mConnection, crtcIds.at(c), size, ramp.constData(), ramp.constData(), ramp.constData());
+        changed = true;
+    }
+    if (changed)
+        xcb_flush(mConnection);
+}
+
+RandRCrtc::Config RandRScreenResources::crtcConfig(xcb_randr_crtc_t crtcId, const QPoint& newOrigin) const
+{
+    // Get the CRTC internal representation:
+    RandRCrtc* crtc = mCrtcs.value(crtcId);
+
+    // Get the associated enabled outputs:
+    QList<xcb_randr_output_t> crtcOutputs = crtc->outputs;
+    for (auto it = crtcOutputs.begin(); it != crtcOutputs.end();) {
+        RandROutput* o = typedOutput(*it);
+        if ((o == nullptr) || !o->mEnabled)
+            it = crtcOutputs.erase(it);
+        else
+            it++;
+    }
+
+    // Move the CRTC or disable it if there is not any associated enabled output:
+    RandRCrtc::Config config;
+    if (crtcOutputs.isEmpty()) {
+        config.x = 0;
+        config.y = 0;
+        config.mode = XCB_NONE;
+        config.rotation = XCB_RANDR_ROTATION_ROTATE_0;
+    } else {
+        config.x = newOrigin.x();
+        config.y = newOrigin.y();
+        config.mode = crtc->mode;
+        config.rotation = crtc->rotation;
+        config.outputs = crtcOutputs;
+    }
+    return config;
+}
+
+QMap<xcb_randr_crtc_t, RandRCrtc::Config> RandRScreenResources::planCrtcs(const QRect& totalScreen, const QRect& newScreen) const
+{
+    QMap<xcb_randr_crtc_t, RandRCrtc::Config> plan;
+
+    for (auto it = mCrtcs.constBegin(); it != mCrtcs.constEnd(); it++) {
+        RandRCrtc::Config config = crtcConfig(it.key(), it.value()->rect().topLeft() - newScreen.topLeft() + totalScreen.topLeft());
+        if (config != it.value()->current)
+            plan.insert(it.key(), config);
+    }
+
+    return plan;
+}
+
+bool RandRScreenResources::validatePlan(const QMap<xcb_randr_crtc_t, RandRCrtc::Config>& plan) const
+{
+    for (auto it = plan.constBegin(); it != plan.constEnd(); it++) {
+        if (!mCrtcs.contains(it.key())) {
+            qWarning() << QObject::tr("Unknown CRTC: %1").arg(it.key());
+            return false;
+        }
+        if (!it.value().enabled())
+            continue;
+
+        QSize crtcSize = modeSize(it.value().mode, it.value().rotation);
+        if (!crtcSize.isValid()) {
+            qWarning() << QObject::tr("Unknown mode %1 for CRTC %2").arg(it.value().mode).arg(it.key());
+            return false;
+        }
+        if ((it.value().x < 0) || (it.value().y < 0)
+         || (it.value().x + crtcSize.width() > mMaxScreenSize.width()) || (it.value().y + crtcSize.height() > mMaxScreenSize.height())) {
+            qWarning() << QObject::tr("CRTC %1 does not fit in the maximum screen size").arg(it.key());
+            return false;
+        }
+        foreach (xcb_randr_output_t outputId, it.value().outputs) {
+            if (!mOutputIds.contains(outputId)) {
+                qWarning() << QObject::tr("Unknown output %1 for CRTC %2").arg(outputId).arg(it.key());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool RandRScreenResources::setCrtcConfigs(const QMap<xcb_randr_crtc_t, RandRCrtc::Config>& plan, bool grab)
+{
+    // Compute and validate all the requests before grabbing the server:
+    if (!validatePlan(plan))
+        return false;
+    QSize newSize = screenSize(plan);
+    QSize growSize = mScreenSize.expandedTo(newSize);
+    QSize newSizeMM = physicalSize(newSize);
+    QSize growSizeMM = physicalSize(growSize);
+    QList<QVector<xcb_randr_output_t>> outputs;
+    for (auto it = plan.constBegin(); it != plan.constEnd(); it++)
+        outputs.append(it.value().enabled() ? QVector<xcb_randr_output_t>::fromList(it.value().outputs) : QVector<xcb_randr_output_t>());
+
+    bool ans = true;
+    {
+        QTraceScope trace(grab ? "serverGrab" : "setCrtcConfig");
+        QElapsedTimer grabTimer;
+        if (grab) {
+            grabTimer.start();
+            xcb_grab_server(mConnection);
+        }
+
+        // Send the whole batch back to back: grow the screen, set the CRTCs and shrink the screen:
+        xcb_void_cookie_t growCookie, shrinkCookie;
+        QList<xcb_randr_set_crtc_config_cookie_t> cookies;
+        if (growSize != mScreenSize) {
+            QStats::count("SetScreenSize");
+            growCookie = xcb_randr_set_screen_size_checked(mConnection, mRoot, growSize.width(), growSize.height(),
+                                                           growSizeMM.width(), growSizeMM.height());
+        }
+        auto outputIt = outputs.constBegin();
+        for (auto it = plan.constBegin(); it != plan.constEnd(); it++, outputIt++) {
+            QStats::count("SetCrtcConfig");
+            cookies.append(xcb_randr_set_crtc_config(mConnection, it.key(), XCB_CURRENT_TIME, mConfigTimestamp,
+                                                     it.value().enabled() ? it.value().x : 0, it.value().enabled() ? it.value().y : 0,
+                                                     it.value().enabled() ? it.value().mode : XCB_NONE,
+                                                     it.value().enabled() ? it.value().rotation : XCB_RANDR_ROTATION_ROTATE_0,
+                                                     outputIt->size(), outputIt->constData()));
+        }
+        if (newSize != growSize) {
+            QStats::count("SetScreenSize");
+            shrinkCookie = xcb_randr_set_screen_size_checked(mConnection, mRoot, newSize.width(), newSize.height(),
+                                                             newSizeMM.width(), newSizeMM.height());
+        }
+
+        // Wait once for the last request (the earlier replies are then already received):
+        bool shrinked = true;
+        if (newSize != growSize) {
+            xcb_generic_error_t* error = xcb_request_check(mConnection, shrinkCookie);
+            shrinked = (error == nullptr);
+            free(error);
+        }
+        if (growSize != mScreenSize) {
+            xcb_generic_error_t* error = xcb_request_check(mConnection, growCookie);
+            if (error == nullptr)
+                updateScreenSize(growSize, growSizeMM);
+            free(error);
+        }
+        auto cookieIt = cookies.constBegin();
+        for (auto it = plan.constBegin(); it != plan.constEnd(); it++, cookieIt++) {
+            xcb_randr_set_crtc_config_reply_t* reply = xcb_randr_set_crtc_config_reply(mConnection, *cookieIt, nullptr);
+            bool success = (reply != nullptr) && (reply->status == XCB_RANDR_SET_CONFIG_SUCCESS);
+            if (success)
+                mCrtcs.value(it.key())->current = it.value();
+            ans &= success;
+            free(reply);
+        }
+        if ((newSize != growSize) && shrinked)
+            updateScreenSize(newSize, newSizeMM);
+
+        // When a CRTC could not be set, fit the screen to the CRTCs which were:
+        QSize fitSize = screenSize(QMap<xcb_randr_crtc_t, RandRCrtc::Config>());
+        if (!ans && (fitSize != mScreenSize)) {
+            QSize fitSizeMM = physicalSize(fitSize);
+            QStats::count("SetScreenSize");
+            xcb_generic_error_t* error = xcb_request_check(mConnection, xcb_randr_set_screen_size_checked(mConnection, mRoot, fitSize.width(), fitSize.height(),
+                                                                                                          fitSizeMM.width(), fitSizeMM.height()));
+            if (error == nullptr)
+                updateScreenSize(fitSize, fitSizeMM);
+            free(error);
+        }
+
+        if (grab) {
+            xcb_ungrab_server(mConnection);
+            xcb_flush(mConnection);
+            QStats::count("GrabServer", grabTimer.nsecsElapsed());
+        }
+    }
+    return ans;
+}
+
+QSize RandRScreenResources::modeSize(xcb_randr_mode_t mode, uint16_t rotation) const
+{
+    QSize size = mModeSizes.value(mode);
+    if ((rotation & (XCB_RANDR_ROTATION_ROTATE_90 | XCB_RANDR_ROTATION_ROTATE_270)) != 0)
+        return size.transposed();
+    return size;
+}
+
+QSize RandRScreenResources::screenSize(const QMap<xcb_randr_crtc_t, RandRCrtc::Config>& plan) const
+{
+    // Compute the bounding box of the enabled CRTCs (the screen always starts at the origin):
+    QSize size(0, 0);
+    for (auto it = mCrtcs.constBegin(); it != mCrtcs.constEnd(); it++) {
+        RandRCrtc::Config config = plan.value(it.key(), it.value()->current);
+        if (!config.enabled())
+            continue;
+        QSize crtcSize = modeSize(config.mode, config.rotation);
+        if (!crtcSize.isValid())
+            return mScreenSize.expandedTo(mMinScreenSize).boundedTo(mMaxScreenSize);
+        size = size.expandedTo(QSize(config.x + crtcSize.width(), config.y + crtcSize.height()));
+    }
+
+    if (size.isEmpty())
+        return mScreenSize;
+    return size.expandedTo(mMinScreenSize).boundedTo(mMaxScreenSize);
+}
+
+QSize RandRScreenResources::physicalSize(const QSize& size) const
+{
+    if (mScreenSize.isEmpty() || mScreenSizeMM.isEmpty())
+        return mScreenSizeMM;
+    return QSize(qRound((qreal) size.width() * mScreenSizeMM.width() / mScreenSize.width()),
+                 qRound((qreal) size.height() * mScreenSizeMM.height() / mScreenSize.height()));
+}
+
+void RandRScreenResources::updateScreenSize(const QSize& size, const QSize& sizeMM)
+{
+    if (size == mScreenSize)
+        return;
+
+    // Report the framebuffer size (assuming 32 bits per pixel) when statistics are requested
+    // (qInfo() is not compiled out of release builds, unlike qDebug()):
+    qint64 oldBytes = 4ll * mScreenSize.width() * mScreenSize.height();
+    qint64 newBytes = 4ll * size.width() * size.height();
+    if (QStats::isEnabled())
+        qInfo() << QObject::tr("Screen resized from %1x%2 to %3x%4: framebuffer of %5 MiB instead of %6 MiB (%7% of the pixels to composite)")
+                   .arg(mScreenSize.width()).arg(mScreenSize.height()).arg(size.width()).arg(size.height())
+                   .arg(newBytes / 1048576., 0, 'f', 1).arg(oldBytes / 1048576., 0, 'f', 1)
+                   .arg(oldBytes > 0 ? 100. * newBytes / oldBytes : 100., 0, 'f', 0);
+    QStats::gauge("FramebufferBytes", newBytes);
+
+    mScreenSize = size;
+    mScreenSizeMM = sizeMM;
+}
@@ -0,0 +1,259 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef RANDRSCREENRESOURCES_H
+#define RANDRSCREENRESOURCES_H
+
+#include "qtypedscreenresources.h"
+#include "randrcrtc.h"
+#include "randroutput.h"
+
+#include <QHash>
+#include <QMap>
+#include <QSize>
+
+typedef uint32_t xcb_window_t;
+typedef uint32_t xcb_timestamp_t;
+typedef uint32_t xcb_randr_crtc_t;
+typedef struct xcb_connection_t xcb_connection_t;
+
+/*!
+ * \brief Internal representation for RandR screen resources
+ *
+ * This class is the base class of the backends using the RandR extension of the X server
+ * (see XRandRScreenResources and XcbScreenResources).
+ * The backends query the screen resources, the outputs and the CRTCs with their own library,
+ * whereas this class plans and applies the CRTC configurations, blanks the outputs
+ * and handles the snapshots on the XCB connection to the X server.
+ */
+class RandRScreenResources : public QTypedScreenResources<RandROutput>
+{
+public:
+    /*!
+     * \brief Destructor
+     *
+     * Desallocates the CRTC internal representations.
+     */
+    ~RandRScreenResources(void);
+
+    /*!
+     * \brief Get a CRTC
+     *
+     * Get a pointer to the corresponding CRTC (Cathode Ray Tube Controller) internal reprsentation.
+     * The CRTC is queried if it is not known yet.
+     * \param crtcId The desired CRTC identifier.
+     * \return The CRTC internal representation corresponding to the given identifier.
+     */
+    RandRCrtc* crtc(xcb_randr_crtc_t crtcId);
+
+    /*!
+     * \brief Can outputs be blanked?
+     *
+     * The outputs are blanked by zeroing the gamma ramp of their CRTC.
+     * \return Always \c true.
+     */
+    inline bool canBlank(void) const {return true;}
+protected:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the class with the given backend name.
+     * The backend sets the XCB connection and the root window,
+     * then the screen resources (see setResources()) and the screen size (see initScreenSize()).
+     * \param name The backend name.
+     */
+    RandRScreenResources(const QString& name);
+
+    /*!
+     * \brief Fetch CRTCs
+     *
+     * Query the information of the given CRTCs (Cathode Ray Tube Controller)
+     * and insert their internal representations in the CRTC map.
+     * \param crtcIds The identifiers of the CRTCs to fetch.
+     */
+    virtual void fetchCrtcs(const QList<xcb_randr_crtc_t>& crtcIds) = 0;
+    /*!
+     * \brief Set the screen resources
+     *
+     * Set the screen resources used to validate and apply the CRTC configurations.
+     * \param crtcIds The identifiers of the CRTCs of the screen.
+     * \param outputIds The identifiers of the outputs of the screen.
+     * \param modeSizes The sizes of the modes of the screen, by mode identifier.
+     * \param configTimestamp The configuration timestamp of the screen resources.
+     */
+    void setResources(const QList<xcb_randr_crtc_t>& crtcIds, const QList<xcb_randr_output_t>& outputIds, const QHash<xcb_randr_mode_t, QSize>& modeSizes, xcb_timestamp_t configTimestamp);
+    /*!
+     * \brief Initialize the screen size
+     *
+     * Set the current screen size and its valid range and report the framebuffer size.
+     * \param size The current screen size (in pixels).
+     * \param sizeMM The current physical screen size (in millimeters).
+     * \param minSize The minimum screen size.
+     * \param maxSize The maximum screen size.
+     */
+    void initScreenSize(const QSize& size, const QSize& sizeMM, const QSize& minSize, const QSize& maxSize);
+
+    /*!
+     * \brief Apply output changes
+     *
+     * Apply the given output changes, updating all the CRTCs in a single pass.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * \param grab Whether to grab the X display.
+     * \return Whether the changes were successfully applied.
+     */
+    bool apply(const QOutputChanges& changes, bool grab);
+    /*!
+     * \brief Write a snapshot
+     *
+     * Write the current configuration of the known CRTCs to the given stream.
+     * \param stream The snapshot stream.
+     */
+    void writeSnapshot(QDataStream& stream) const;
+    /*!
+     * \brief Apply a snapshot
+     *
+     * Read the CRTC configurations from the given stream
+     * and apply the ones which differ from the current ones while the server is grabbed.
+     * The zeroed gamma ramps of the CRTCs are also reset (see resetZeroedGammas()).
+     * \param stream The snapshot stream.
+     * \return Whether the snapshot was applied.
+     */
+    bool readSnapshot(QDataStream& stream);
+    /*!
+     * \brief Blank an output
+     *
+     * Zero the gamma ramp of the CRTC of the given output, after saving it, or restore the saved gamma ramp.
+     * The CRTC configuration is not modified. As the gamma ramp is shared by all the outputs of the CRTC (clone mode),
+     * it is only restored when none of them is blanked.
+     * \param output The output to blank or unblank.
+     * \param blanked Whether the output should be blanked.
+     * \return Whether the output was successfully blanked or unblanked.
+     */
+    bool blank(QOutput* output, bool blanked);
+
+    xcb_connection_t* mConnection;                  /*!< The XCB connection to the X server */
+    xcb_window_t mRoot;                             /*!< The root window of the screen */
+    QMap<xcb_randr_crtc_t, RandRCrtc*> mCrtcs;      /*!< The map of CRTC internal representations */
+    QSize mScreenSize;                              /*!< The current screen size (in pixels) */
+    QSize mScreenSizeMM;                            /*!< The current physical screen size (in millimeters) */
+private:
+    /*!
+     * \brief Reset zeroed gamma ramps
+     *
+     * Reset the gamma ramp of the given CRTCs to a linear ramp if it is zeroed,
+     * so that the outputs blanked by a process which was killed are visible again.
+     * All the gamma ramps are requested before waiting for any reply.
+     * \param crtcIds The identifiers of the CRTCs.
+     * \sa blank(), readSnapshot()
+     */
+    void resetZeroedGammas(const QList<xcb_randr_crtc_t>& crtcIds);
+    /*!
+     * \brief Compute a CRTC configuration
+     *
+     * Compute the target configuration of a CRTC (Cathode Ray Tube Controller)
+     * with the given top left point. The CRTC is disabled
+     * if there is not any associated enabled output.
+     * \param crtcId The identifier of the CRTC.
+     * \param newOrigin The new coordinates of the CRTC top left point.
+     * \return The target configuration of the CRTC.
+     * \sa planCrtcs()
+     */
+    RandRCrtc::Config crtcConfig(xcb_randr_crtc_t crtcId, const QPoint& newOrigin) const;
+    /*!
+     * \brief Plan the CRTC updates
+     *
+     * Compute the target configuration of all the CRTCs
+     * and keep only the ones which differ from the current configuration.
+     * \param totalScreen The screen rectangle when all outputs are on.
+     * \param newScreen The screen rectangle when only enabled outputs are on.
+     * \return The target configurations of the CRTCs which change.
+     * \sa crtcConfig(), setCrtcConfigs()
+     */
+    QMap<xcb_randr_crtc_t, RandRCrtc::Config> planCrtcs(const QRect& totalScreen, const QRect& newScreen) const;
+    /*!
+     * \brief Validate a plan
+     *
+     * Check that the target configurations of the CRTCs can be sent to the server:
+     * the CRTCs, modes and outputs should be known and the CRTCs should fit in the maximum screen size.
+     * \param plan The target configurations of the CRTCs which change.
+     * \return Whether the plan is valid.
+     * \sa planCrtcs(), setCrtcConfigs()
+     */
+    bool validatePlan(const QMap<xcb_randr_crtc_t, RandRCrtc::Config>& plan) const;
+    /*!
+     * \brief Set CRTC configurations
+     *
+     * Set the configuration of the given CRTCs (Cathode Ray Tube Controller),
+     * resizing the screen to the bounding box of the enabled CRTCs,
+     * and update the cached CRTC states on success.
+     *
+     * All the requests are computed and validated before the server is grabbed.
+     * Then, they are sent back to back, the replies are waited for once and the server is ungrabbed.
+     * The time during which the server is grabbed is accounted to the \c GrabServer requests in QStats.
+     * \param plan The target configurations of the CRTCs which change.
+     * \param grab Whether to grab the X server.
+     * \return Whether all the CRTC configurations were successfully set.
+     * \sa planCrtcs(), validatePlan(), screenSize()
+     */
+    bool setCrtcConfigs(const QMap<xcb_randr_crtc_t, RandRCrtc::Config>& plan, bool grab);
+    /*!
+     * \brief Size of a mode
+     *
+     * Compute the size that a CRTC spans on the screen with the given mode and rotation.
+     * \param mode The mode of the CRTC.
+     * \param rotation The rotation of the CRTC.
+     * \return The size of the CRTC on the screen, or an empty size if the mode is unknown.
+     */
+    QSize modeSize(xcb_randr_mode_t mode, uint16_t rotation) const;
+    /*!
+     * \brief Screen size for a plan
+     *
+     * Compute the screen size which fits the enabled CRTCs once the given plan is applied.
+     * The result is bounded by the screen size range of the server.
+     * \param plan The target configurations of the CRTCs which change.
+     * \return The smallest valid screen size which contains all the enabled CRTCs.
+     * \sa planCrtcs(), setCrtcConfigs()
+     */
+    QSize screenSize(const QMap<xcb_randr_crtc_t, RandRCrtc::Config>& plan) const;
+    /*!
+     * \brief Physical screen size
+     *
+     * Compute the physical size of the screen with the given size,
+     * so that the resolution does not change.
+     * \param size The screen size (in pixels).
+     * \return The physical screen size (in millimeters).
+     */
+    QSize physicalSize(const QSize& size) const;
+    /*!
+     * \brief Update the screen size
+     *
+     * Update the cached screen size after a resize and report the framebuffer size.
+     * \param size The new screen size (in pixels).
+     * \param sizeMM The new physical screen size (in millimeters).
+     */
+    void updateScreenSize(const QSize& size, const QSize& sizeMM);
+
+    QSize mMinScreenSize;                           /*!< The minimum screen size */
+    QSize mMaxScreenSize;                           /*!< The maximum screen size */
+    QList<xcb_randr_crtc_t> mCrtcIds;               /*!< The identifiers of the CRTCs of the screen */
+    QList<xcb_randr_output_t> mOutputIds;           /*!< The identifiers of the outputs of the screen */
+    QHash<xcb_randr_mode_t, QSize> mModeSizes;      /*!< The sizes of the modes of the screen */
+    xcb_timestamp_t mConfigTimestamp;               /*!< The configuration timestamp of the screen resources */
+};
+
+#endif // RANDRSCREENRESOURCES_H
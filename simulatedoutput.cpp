@@ -0,0 +1,37 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "simulatedoutput.h"
+#include "simulatedscreenresources.h"
+
+#include <QObject>
+
+SimulatedOutput::SimulatedOutput(SimulatedScreenResources* parent, QOutputId outputId, int crtc, bool connected)
+    : QOutput(parent), mCrtc(crtc)
+{
+    id = outputId;
+    name = QString("SIM-%1").arg(outputId);
+    physicalWidth = 0;
+    physicalHeight = 0;
+    connection = connected ? QOutput::Connection::Connected : QOutput::Connection::Disconnected;
+}
+
+QString SimulatedOutput::display(void) const
+{
+    return QObject::tr("Simulated output %1").arg(id);
+}
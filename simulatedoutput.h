@@ -0,0 +1,61 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef SIMULATEDOUTPUT_H
+#define SIMULATEDOUTPUT_H
+
+#include "qoutput.h"
+
+#include <QString>
+
+class SimulatedScreenResources;
+
+/*!
+ * \brief Internal representation for simulated output
+ *
+ * Instances of this class represent an output of the simulated topology.
+ */
+class SimulatedOutput : public QOutput
+{
+public:
+    /*!
+     * \brief User-friendly name of this output
+     *
+     * Returns a user-friendly name for the output.
+     * \return A user-friendly name for the output.
+     */
+    QString display(void) const;
+
+private:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the class with the given information.
+     * \param parent The parent screen resources.
+     * \param outputId The output identifier.
+     * \param crtc The index of the associated CRTC.
+     * \param connected Whether the output is connected.
+     */
+    SimulatedOutput(SimulatedScreenResources* parent, QOutputId outputId, int crtc, bool connected);
+
+    int mCrtc;  /*!< The index of the associated CRTC */
+
+    friend class SimulatedScreenResources;
+};
+
+#endif // SIMULATEDOUTPUT_H
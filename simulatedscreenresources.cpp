@@ -0,0 +1,242 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "simulatedscreenresources.h"
+#include "simulatedoutput.h"
+#include "qstats.h"
+#include "qtracer.h"
+
+#include <QDataStream>
+#include <QObject>
+#include <QThread>
+#include <QtDebug>
+
+QString SimulatedScreenResources::name = "Simulated";
+
+QScreenResources* SimulatedScreenResources::create(bool forceBackend)
+{
+    // Never selected automatically:
+    if (!forceBackend)
+        return nullptr;
+
+    QMap<QString, int> config;
+    config.insert("outputs", 4);
+    config.insert("width", 1920);
+    config.insert("height", 1080);
+    config.insert("latency", 0);
+
+    QString spec = QString::fromLocal8Bit(qgetenv("SHUTDOWN_MONITOR_SIMULATED"));
+    foreach (QString entry, spec.split(',', Qt::SkipEmptyParts)) {
+        QStringList keyValue = entry.split('=');
+        bool ok = (keyValue.size() == 2);
+        int value = ok ? keyValue.at(1).trimmed().toInt(&ok) : 0;
+        if (!ok || (value < 0)) {
+            qWarning() << QObject::tr("Invalid simulated topology entry: %1").arg(entry);
+            return nullptr;
+        }
+        config.insert(keyValue.at(0).trimmed(), value);
+    }
+
+    if (!config.contains("crtcs"))
+        config.insert("crtcs", config.value("outputs"));
+    if (!config.contains("columns"))
+        config.insert("columns", config.value("crtcs"));
+    if (!config.contains("connected"))
+        config.insert("connected", config.value("outputs"));
+    if ((config.value("outputs") <= 0) || (config.value("crtcs") <= 0) || (config.value("columns") <= 0)) {
+        qWarning() << QObject::tr("The simulated topology needs at least one output, one CRTC and one column");
+        return nullptr;
+    }
+
+    return new SimulatedScreenResources(config);
+}
+
+SimulatedScreenResources::SimulatedScreenResources(const QMap<QString, int>& config)
+    : QTypedScreenResources<SimulatedOutput>(SimulatedScreenResources::name),
+      mLatency(config.value("latency")), mConnected(config.value("connected")), mOutputCount(config.value("outputs"))
+{
+    int width = config.value("width");
+    int height = config.value("height");
+    int columns = config.value("columns");
+
+    // Place the CRTCs on a grid:
+    mCrtcs.resize(config.value("crtcs"));
+    for (int c = 0; c < mCrtcs.size(); c++) {
+        mCrtcs[c].rect = QRect((c % columns) * width, (c / columns) * height, width, height);
+        mCrtcs[c].position = mCrtcs[c].rect.topLeft();
+    }
+
+    // Connected outputs are initially enabled:
+    for (int o = 0; o < qMin(mConnected, mOutputCount); o++)
+        mCrtcs[o % mCrtcs.size()].outputs.append(o + 1);
+}
+
+SimulatedScreenResources::~SimulatedScreenResources(void)
+{
+    for (auto it = mCounters.constBegin(); it != mCounters.constEnd(); it++)
+        qDebug() << QString("%1: %2").arg(it.key()).arg(it.value());
+}
+
+void SimulatedScreenResources::primitive(const QString& operation)
+{
+    mCounters[operation]++;
+    QStats::count(operation);
+    if (mLatency > 0)
+        QThread::usleep(mLatency);
+}
+
+void SimulatedScreenResources::refreshOutputs(void)
+{
+    QTraceScope trace("refreshOutputs");
+    QStatsOperation stats("refresh");
+    primitive("GetScreenResources");
+    for (int o = 0; o < mOutputCount; o++) {
+        primitive("GetOutputInfo");
+        QOutputId outputId = o + 1;
+        SimulatedOutput* sOutput = typedOutput(outputId);
+        if (sOutput == nullptr) {
+            sOutput = new SimulatedOutput(this, outputId, o % mCrtcs.size(), o < mConnected);
+            mOutputs.insert(sOutput);
+        }
+        sOutput->mEnabled = mCrtcs.at(sOutput->mCrtc).outputs.contains(outputId);
+        mLayout.set(outputId, mCrtcs.at(sOutput->mCrtc).rect, 0, sOutput->connection == QOutput::Connection::Connected, sOutput->mEnabled);
+    }
+    updateNameIndex();
+}
+
+bool SimulatedScreenResources::apply(const QOutputChanges& changes, bool grab)
+{
+    QMap<SimulatedOutput*, bool> oldOutputStates;
+    auto restoreOutputStates = [&oldOutputStates] {
+        for (auto it = oldOutputStates.constBegin(); it != oldOutputStates.constEnd(); it++)
+            it.key()->setEnabled(it.value());
+    };
+
+    // Update the output states:
+    for (auto it = changes.constBegin(); it != changes.constEnd(); it++) {
+        SimulatedOutput* sOutput = typedOutput(it.key());
+        if ((sOutput == nullptr) || (sOutput->connection != QOutput::Connection::Connected)) {
+            restoreOutputStates();
+            return false;
+        }
+
+        oldOutputStates.insert(sOutput, sOutput->mEnabled);
+        sOutput->setEnabled(it.value());
+    }
+
+    // At least one output should remain enabled:
+    QRect totalScreen = mLayout.totalScreen();
+    QRect newScreen = mLayout.screen();
+    if (newScreen.isNull()) {
+        restoreOutputStates();
+        return false;
+    }
+
+    // Compute the new CRTC configurations:
+    QVector< QList<QOutputId> > crtcOutputs(mCrtcs.size());
+    for (SimulatedOutput* sOutput : typedOutputs()) {
+        if (sOutput->mEnabled)
+            crtcOutputs[sOutput->mCrtc].append(sOutput->id);
+    }
+
+    // Update only the CRTCs which change:
+    if (grab)
+        primitive("GrabServer");
+    for (int c = 0; c < mCrtcs.size(); c++) {
+        QPoint position = crtcOutputs.at(c).isEmpty() ? mCrtcs.at(c).rect.topLeft() : mCrtcs.at(c).rect.topLeft() - newScreen.topLeft() + totalScreen.topLeft();
+        if ((crtcOutputs.at(c) == mCrtcs.at(c).outputs) && (crtcOutputs.at(c).isEmpty() || (position == mCrtcs.at(c).position)))
+            continue;
+        primitive("SetCrtcConfig");
+        mCrtcs[c].outputs = crtcOutputs.at(c);
+        mCrtcs[c].position = position;
+    }
+    if (grab)
+        primitive("UngrabServer");
+    return true;
+}
+
+void SimulatedScreenResources::writeSnapshot(QDataStream& stream) const
+{
+    stream << (quint32) mCrtcs.size();
+    foreach (Crtc crtc, mCrtcs) {
+        stream << crtc.position << (quint32) crtc.outputs.size();
+        foreach (QOutputId outputId, crtc.outputs)
+            stream << (quint32) outputId;
+    }
+}
+
+bool SimulatedScreenResources::readSnapshot(QDataStream& stream)
+{
+    // Read the CRTC configurations:
+    quint32 crtcCount = 0;
+    stream >> crtcCount;
+    if (crtcCount != (quint32) mCrtcs.size()) {
+        qWarning() << QObject::tr("Invalid snapshot");
+        return false;
+    }
+    QVector<QPoint> positions(mCrtcs.size());
+    QVector< QList<QOutputId> > crtcOutputs(mCrtcs.size());
+    for (int c = 0; (c < mCrtcs.size()) && (stream.status() == QDataStream::Ok); c++) {
+        quint32 outputCount = 0;
+        stream >> positions[c] >> outputCount;
+        for (quint32 o = 0; (o < outputCount) && (stream.status() == QDataStream::Ok); o++) {
+            quint32 outputId;
+            stream >> outputId;
+            crtcOutputs[c].append(outputId);
+        }
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << QObject::tr("Invalid snapshot");
+        return false;
+    }
+
+    // Update only the CRTCs which change:
+    primitive("GrabServer");
+    for (int c = 0; c < mCrtcs.size(); c++) {
+        if ((crtcOutputs.at(c) == mCrtcs.at(c).outputs) && (crtcOutputs.at(c).isEmpty() || (positions.at(c) == mCrtcs.at(c).position)))
+            continue;
+        primitive("SetCrtcConfig");
+        mCrtcs[c].outputs = crtcOutputs.at(c);
+        mCrtcs[c].position = positions.at(c);
+    }
+    primitive("UngrabServer");
+
+    // Update the output states:
+    for (SimulatedOutput* sOutput : typedOutputs())
+        sOutput->setEnabled(mCrtcs.at(sOutput->mCrtc).outputs.contains(sOutput->id));
+    return true;
+}
+
+bool SimulatedScreenResources::blank(QOutput* output, bool blanked)
+{
+    SimulatedOutput* sOutput = typedOutput(output->id);
+    if ((sOutput == nullptr) || (sOutput->connection != QOutput::Connection::Connected))
+        return false;
+
+    // The gamma ramp is shared by the outputs of the CRTC:
+    for (SimulatedOutput* o : typedOutputs()) {
+        if ((o != sOutput) && (o->mCrtc == sOutput->mCrtc) && o->blanked())
+            return true;
+    }
+
+    // The gamma ramp is saved before it is zeroed:
+    if (blanked)
+        primitive("GetCrtcGamma");
+    primitive("SetCrtcGamma");
+    return true;
+}
@@ -0,0 +1,165 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef SIMULATEDSCREENRESOURCES_H
+#define SIMULATEDSCREENRESOURCES_H
+
+#include "qtypedscreenresources.h"
+
+#include <QMap>
+#include <QRect>
+#include <QVector>
+
+class SimulatedOutput;
+
+/*!
+ * \brief Internal representation for simulated screen resources
+ *
+ * This class holds a synthetic topology, which is configured with
+ * the \c SHUTDOWN_MONITOR_SIMULATED environment variable, e.g.
+ * \code
+ * SHUTDOWN_MONITOR_SIMULATED="outputs=64,crtcs=64,columns=8,latency=500"
+ * \endcode
+ * The recognized keys are:
+ *   - \c outputs The number of outputs (defaults to 4).
+ *   - \c connected The number of connected outputs (defaults to all).
+ *   - \c crtcs The number of CRTCs (defaults to the number of outputs).
+ *     When there are less CRTCs than outputs, the CRTCs are shared (clone mode).
+ *   - \c columns The number of columns of the CRTC grid (defaults to the number of CRTCs).
+ *   - \c width and \c height The size of the CRTCs (defaults to 1920x1080).
+ *   - \c latency The latency of each primitive operation (in µs, defaults to 0).
+ *
+ * The layout and offset logic is the same as in the X11 backend.
+ * Every primitive operation (which would be a request to the X server) is counted.
+ */
+class SimulatedScreenResources : public QTypedScreenResources<SimulatedOutput>
+{
+public:
+    static QString name;    /*!< Backend name */
+    /*!
+     * \brief Screen resources factory
+     *
+     * This method creates a new screen resource instance,
+     * if the backend was specified.
+     * \param forceBackend Whether the backend name was specified.
+     * \return A new screen resources instance if the backend was specified,
+     * otherwise, \c nullptr.
+     */
+    static QScreenResources* create(bool forceBackend);
+
+    /*!
+     * \brief Destructor
+     *
+     * Desallocates the internal data.
+     */
+    ~SimulatedScreenResources(void);
+
+    /*!
+     * \brief Primitive operation counters
+     *
+     * Returns the number of calls to each primitive operation.
+     * \return The number of calls to each primitive operation, by operation name.
+     */
+    inline const QMap<QString, quint64>& counters(void) const {return mCounters;}
+
+    /*!
+     * \brief Can outputs be blanked?
+     *
+     * The outputs are blanked as in the X11 backend.
+     * \return Always \c true.
+     */
+    inline bool canBlank(void) const {return true;}
+private:
+    /*!
+     * \brief Simulated CRTC
+     *
+     * Instances of this structure represent a CRTC of the simulated topology.
+     */
+    struct Crtc {
+        QRect rect;                 /*!< The original rectangle of the CRTC on the screen */
+        QPoint position;            /*!< The current position of the CRTC on the screen */
+        QList<QOutputId> outputs;   /*!< The currently associated outputs */
+    };
+
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the class with the given configuration.
+     * \param config The configuration of the simulated topology.
+     * \sa create()
+     */
+    SimulatedScreenResources(const QMap<QString, int>& config);
+
+    /*!
+     * \brief Primitive operation
+     *
+     * Count a primitive operation and wait for the configured latency.
+     * \param operation The name of the operation.
+     */
+    void primitive(const QString& operation);
+
+    /*!
+     * \brief Refresh the cached output list
+     *
+     * Refresh the QList of output internal representations.
+     */
+    void refreshOutputs(void);
+    /*!
+     * \brief Apply output changes
+     *
+     * Apply the given output changes, updating all the CRTCs in a single pass.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * \param grab Whether to grab the (simulated) display.
+     * \return Whether the changes were successfully applied.
+     */
+    bool apply(const QOutputChanges& changes, bool grab);
+    /*!
+     * \brief Write a snapshot
+     *
+     * Write the position and the outputs of each CRTC to the given stream.
+     * \param stream The snapshot stream.
+     */
+    void writeSnapshot(QDataStream& stream) const;
+    /*!
+     * \brief Apply a snapshot
+     *
+     * Read the CRTC positions and outputs from the given stream
+     * and apply the ones which differ from the current ones.
+     * \param stream The snapshot stream.
+     * \return Whether the snapshot was applied.
+     */
+    bool readSnapshot(QDataStream& stream);
+    /*!
+     * \brief Blank an output
+     *
+     * Simulate the gamma ramp update of the CRTC of the given output,
+     * which is shared by all the outputs of the CRTC.
+     * \param output The output to blank or unblank.
+     * \param blanked Whether the output should be blanked.
+     * \return Whether the output was successfully blanked or unblanked.
+     */
+    bool blank(QOutput* output, bool blanked);
+
+    int mLatency;                       /*!< The latency of primitive operations (in µs) */
+    int mConnected;                     /*!< The number of connected outputs */
+    int mOutputCount;                   /*!< The number of outputs */
+    QVector<Crtc> mCrtcs;               /*!< The simulated CRTCs */
+    QMap<QString, quint64> mCounters;   /*!< The number of calls to each primitive operation */
+};
+
+#endif // SIMULATEDSCREENRESOURCES_H
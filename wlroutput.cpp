@@ -0,0 +1,75 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "wlroutput.h"
+#include "wlrscreenresources.h"
+
+#include <QtDebug>
+
+#include <wayland-client.h>
+
+WlrOutput::WlrOutput(WlrScreenResources* parent, QOutputId outputId, zwlr_output_head_v1* head)
+    : QOutput(parent), mHead(head), mLastMode(nullptr)
+{
+    id = outputId;
+    physicalWidth = 0;
+    physicalHeight = 0;
+    // The heads are only advertised while they are connected:
+    connection = QOutput::Connection::Connected;
+
+    mEnabled = false;
+}
+
+QRect WlrOutput::rect(const Config& config) const
+{
+    if (!mModes.contains(config.mode) || (config.scale <= 0))
+        return QRect();
+
+    // The odd transforms are rotated by 90 or 270 degrees:
+    QSize size = mModes.value(config.mode).size;
+    if ((config.transform & 1) != 0)
+        size.transpose();
+    double scale = wl_fixed_to_double(config.scale);
+    return QRect(config.position, QSize(qRound(size.width() / scale), qRound(size.height() / scale)));
+}
+
+zwlr_output_mode_v1* WlrOutput::enableMode(void) const
+{
+    if (mModes.contains(current.mode))
+        return current.mode;
+    if (mModes.contains(mLastMode))
+        return mLastMode;
+    for (auto it = mModes.constBegin(); it != mModes.constEnd(); it++) {
+        if (it.value().preferred)
+            return it.key();
+    }
+    return !mModes.isEmpty() ? mModes.firstKey() : nullptr;
+}
+
+QString WlrOutput::display(void) const
+{
+    if (name.isNull() || !current.enabled)
+        return name;
+
+    QRect r = rect(current);
+    return QString("%1 (%2x%3+%4+%5)").arg(name)
+                                      .arg(r.width())
+                                      .arg(r.height())
+                                      .arg(r.x())
+                                      .arg(r.y());
+}
@@ -0,0 +1,117 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef WLROUTPUT_H
+#define WLROUTPUT_H
+
+#include "qoutput.h"
+
+#include <QMap>
+#include <QRect>
+#include <QString>
+
+struct zwlr_output_head_v1;
+struct zwlr_output_mode_v1;
+
+class WlrScreenResources;
+
+/*!
+ * \brief Internal representation for wlroots output head
+ *
+ * Instances of this class represent an output head (monitor, ...)
+ * advertised by the \c zwlr_output_manager_v1 Wayland protocol.
+ * Contrary to KScreen outputs, the heads remain advertised when they are disabled.
+ */
+class WlrOutput : public QOutput
+{
+public:
+    /*!
+     * \brief Output mode
+     *
+     * Instances of this structure describe a mode advertised for a head.
+     */
+    struct Mode {
+        QSize size;             /*!< The size of the mode (in hardware pixels) */
+        int refresh = 0;        /*!< The refresh rate of the mode (in mHz), or 0 if unknown */
+        bool preferred = false; /*!< Whether the mode is preferred */
+    };
+
+    /*!
+     * \brief Head configuration
+     *
+     * Instances of this structure hold the configuration of a head,
+     * as it is set with a \c zwlr_output_configuration_v1 object.
+     */
+    struct Config {
+        bool enabled = false;                   /*!< Whether the head is enabled */
+        QPoint position;                        /*!< The position of the head in the compositor space */
+        zwlr_output_mode_v1* mode = nullptr;    /*!< The mode of the head */
+        int32_t transform = 0;                  /*!< The transform of the head (see \c wl_output.transform) */
+        int32_t scale = 256;                    /*!< The scale of the head (as a \c wl_fixed_t) */
+    };
+
+    Config current; /*!< The configuration currently set in the compositor */
+
+    /*!
+     * \brief User-friendly name of this output
+     *
+     * Returns a user-friendly name for the output.
+     * \return A user-friendly name for the output.
+     */
+    QString display(void) const;
+    /*!
+     * \brief Output rectangle
+     *
+     * Compute the rectangle that the head spans in the compositor space
+     * with the given configuration, taking the transform and the scale into account.
+     * \param config A configuration of the head.
+     * \return The rectangle that the head spans in the compositor space,
+     * or a null rectangle if the configuration does not have any known mode.
+     */
+    QRect rect(const Config& config) const;
+private:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the class with the given information.
+     * The properties are filled by the head events.
+     * \param parent The parent screen resources.
+     * \param outputId The output identifier.
+     * \param head The Wayland head object.
+     */
+    WlrOutput(WlrScreenResources* parent, QOutputId outputId, zwlr_output_head_v1* head);
+    /*!
+     * \brief Mode to enable the head
+     *
+     * Returns the mode to use when enabling the head: the current mode,
+     * or the last mode which was used, or the preferred mode, or the first mode.
+     * \return The mode to use when enabling the head, or \c nullptr if no mode is advertised.
+     */
+    zwlr_output_mode_v1* enableMode(void) const;
+
+    zwlr_output_head_v1* mHead;                     /*!< The Wayland head object */
+    QString mDescription;                           /*!< The description of the head */
+    QMap<zwlr_output_mode_v1*, Mode> mModes;        /*!< The modes advertised for the head */
+    zwlr_output_mode_v1* mLastMode;                 /*!< The last mode which was used */
+    QRect mRect;                                    /*!< The output rect in the compositor space from the original configuration */
+
+    friend class WlrScreenResources;
+    friend struct WlrListeners;
+};
+
+#endif // WLROUTPUT_H
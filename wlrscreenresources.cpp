@@ -0,0 +1,685 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "wlrscreenresources.h"
+#include "wlroutput.h"
+#include "qstats.h"
+#include "qtracer.h"
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QSocketNotifier>
+#include <QtDebug>
+
+#include <wayland-client.h>
+#include "wlr-output-management-unstable-v1-client-protocol.h"
+
+QString WlrScreenResources::name = "Wlr";
+
+/*!
+ * \brief Wayland listeners
+ *
+ * This structure holds the Wayland listeners of the backend.
+ * They forward the protocol events to the screen resources and to the outputs.
+ */
+struct WlrListeners
+{
+    static void registryGlobal(void* data, wl_registry* registry, uint32_t id, const char* interface, uint32_t version);
+    static void registryGlobalRemove(void* data, wl_registry* registry, uint32_t id);
+
+    static void managerHead(void* data, zwlr_output_manager_v1* manager, zwlr_output_head_v1* head);
+    static void managerDone(void* data, zwlr_output_manager_v1* manager, uint32_t serial);
+    static void managerFinished(void* data, zwlr_output_manager_v1* manager);
+
+    static void headName(void* data, zwlr_output_head_v1* head, const char* name);
+    static void headDescription(void* data, zwlr_output_head_v1* head, const char* description);
+    static void headPhysicalSize(void* data, zwlr_output_head_v1* head, int32_t width, int32_t height);
+    static void headMode(void* data, zwlr_output_head_v1* head, zwlr_output_mode_v1* mode);
+    static void headEnabled(void* data, zwlr_output_head_v1* head, int32_t enabled);
+    static void headCurrentMode(void* data, zwlr_output_head_v1* head, zwlr_output_mode_v1* mode);
+    static void headPosition(void* data, zwlr_output_head_v1* head, int32_t x, int32_t y);
+    static void headTransform(void* data, zwlr_output_head_v1* head, int32_t transform);
+    static void headScale(void* data, zwlr_output_head_v1* head, wl_fixed_t scale);
+    static void headFinished(void* data, zwlr_output_head_v1* head);
+    static void headString(void* data, zwlr_output_head_v1* head, const char* value);
+    static void headAdaptiveSync(void* data, zwlr_output_head_v1* head, uint32_t state);
+
+    static void modeSize(void* data, zwlr_output_mode_v1* mode, int32_t width, int32_t height);
+    static void modeRefresh(void* data, zwlr_output_mode_v1* mode, int32_t refresh);
+    static void modePreferred(void* data, zwlr_output_mode_v1* mode);
+    static void modeFinished(void* data, zwlr_output_mode_v1* mode);
+
+    static void configurationSucceeded(void* data, zwlr_output_configuration_v1* configuration);
+    static void configurationFailed(void* data, zwlr_output_configuration_v1* configuration);
+    static void configurationCancelled(void* data, zwlr_output_configuration_v1* configuration);
+    static void configurationFinished(void* data, zwlr_output_configuration_v1* configuration, bool success);
+
+    static void releaseMode(zwlr_output_mode_v1* mode);
+
+    static const wl_registry_listener registry;
+    static const zwlr_output_manager_v1_listener manager;
+    static const zwlr_output_head_v1_listener head;
+    static const zwlr_output_mode_v1_listener mode;
+    static const zwlr_output_configuration_v1_listener configuration;
+};
+
+const wl_registry_listener WlrListeners::registry = {
+    &WlrListeners::registryGlobal,
+    &WlrListeners::registryGlobalRemove,
+};
+
+const zwlr_output_manager_v1_listener WlrListeners::manager = {
+    &WlrListeners::managerHead,
+    &WlrListeners::managerDone,
+    &WlrListeners::managerFinished,
+};
+
+const zwlr_output_head_v1_listener WlrListeners::head = {
+    &WlrListeners::headName,
+    &WlrListeners::headDescription,
+    &WlrListeners::headPhysicalSize,
+    &WlrListeners::headMode,
+    &WlrListeners::headEnabled,
+    &WlrListeners::headCurrentMode,
+    &WlrListeners::headPosition,
+    &WlrListeners::headTransform,
+    &WlrListeners::headScale,
+    &WlrListeners::headFinished,
+    &WlrListeners::headString,
+    &WlrListeners::headString,
+    &WlrListeners::headString,
+    &WlrListeners::headAdaptiveSync,
+};
+
+const zwlr_output_mode_v1_listener WlrListeners::mode = {
+    &WlrListeners::modeSize,
+    &WlrListeners::modeRefresh,
+    &WlrListeners::modePreferred,
+    &WlrListeners::modeFinished,
+};
+
+const zwlr_output_configuration_v1_listener WlrListeners::configuration = {
+    &WlrListeners::configurationSucceeded,
+    &WlrListeners::configurationFailed,
+    &WlrListeners::configurationCancelled,
+};
+
+void WlrListeners::registryGlobal(void* data, wl_registry* registry, uint32_t id, const char* interface, uint32_t version)
+{
+    WlrScreenResources* resources = static_cast<WlrScreenResources*>(data);
+    if ((resources->mManager != nullptr) || (qstrcmp(interface, zwlr_output_manager_v1_interface.name) != 0))
+        return;
+
+    resources->mManagerVersion = qMin<uint32_t>(version, zwlr_output_manager_v1_interface.version);
+    resources->mManager = static_cast<zwlr_output_manager_v1*>(wl_registry_bind(registry, id, &zwlr_output_manager_v1_interface, resources->mManagerVersion));
+    zwlr_output_manager_v1_add_listener(resources->mManager, &WlrListeners::manager, resources);
+}
+
+void WlrListeners::registryGlobalRemove(void* data, wl_registry* registry, uint32_t id)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(registry);
+    Q_UNUSED(id);
+}
+
+void WlrListeners::managerHead(void* data, zwlr_output_manager_v1* manager, zwlr_output_head_v1* head)
+{
+    Q_UNUSED(manager);
+    WlrScreenResources* resources = static_cast<WlrScreenResources*>(data);
+
+    // The output is added to the output list when the head state is complete:
+    WlrOutput* output = new WlrOutput(resources, resources->mNextId++, head);
+    resources->mHeads.insert(head, output);
+    zwlr_output_head_v1_add_listener(head, &WlrListeners::head, output);
+}
+
+void WlrListeners::managerDone(void* data, zwlr_output_manager_v1* manager, uint32_t serial)
+{
+    Q_UNUSED(manager);
+    WlrScreenResources* resources = static_cast<WlrScreenResources*>(data);
+
+    resources->mSerial = serial;
+    resources->mInitialized = true;
+    resources->commitHeads();
+}
+
+void WlrListeners::managerFinished(void* data, zwlr_output_manager_v1* manager)
+{
+    WlrScreenResources* resources = static_cast<WlrScreenResources*>(data);
+
+    qWarning() << QObject::tr("The compositor stopped the output management");
+    zwlr_output_manager_v1_destroy(manager);
+    resources->mManager = nullptr;
+}
+
+void WlrListeners::headName(void* data, zwlr_output_head_v1* head, const char* name)
+{
+    Q_UNUSED(head);
+    static_cast<WlrOutput*>(data)->name = QString::fromUtf8(name);
+}
+
+void WlrListeners::headDescription(void* data, zwlr_output_head_v1* head, const char* description)
+{
+    Q_UNUSED(head);
+    static_cast<WlrOutput*>(data)->mDescription = QString::fromUtf8(description);
+}
+
+void WlrListeners::headPhysicalSize(void* data, zwlr_output_head_v1* head, int32_t width, int32_t height)
+{
+    Q_UNUSED(head);
+    WlrOutput* output = static_cast<WlrOutput*>(data);
+    output->physicalWidth = width;
+    output->physicalHeight = height;
+}
+
+void WlrListeners::headMode(void* data, zwlr_output_head_v1* head, zwlr_output_mode_v1* mode)
+{
+    Q_UNUSED(head);
+    WlrOutput* output = static_cast<WlrOutput*>(data);
+    output->mModes.insert(mode, WlrOutput::Mode());
+    zwlr_output_mode_v1_add_listener(mode, &WlrListeners::mode, output);
+}
+
+void WlrListeners::headEnabled(void* data, zwlr_output_head_v1* head, int32_t enabled)
+{
+    Q_UNUSED(head);
+    WlrOutput* output = static_cast<WlrOutput*>(data);
+
+    // The current mode is not advertised for disabled heads:
+    output->current.enabled = (enabled != 0);
+    if (!output->current.enabled && (output->current.mode != nullptr)) {
+        output->mLastMode = output->current.mode;
+        output->current.mode = nullptr;
+    }
+}
+
+void WlrListeners::headCurrentMode(void* data, zwlr_output_head_v1* head, zwlr_output_mode_v1* mode)
+{
+    Q_UNUSED(head);
+    static_cast<WlrOutput*>(data)->current.mode = mode;
+}
+
+void WlrListeners::headPosition(void* data, zwlr_output_head_v1* head, int32_t x, int32_t y)
+{
+    Q_UNUSED(head);
+    static_cast<WlrOutput*>(data)->current.position = QPoint(x, y);
+}
+
+void WlrListeners::headTransform(void* data, zwlr_output_head_v1* head, int32_t transform)
+{
+    Q_UNUSED(head);
+    static_cast<WlrOutput*>(data)->current.transform = transform;
+}
+
+void WlrListeners::headScale(void* data, zwlr_output_head_v1* head, wl_fixed_t scale)
+{
+    Q_UNUSED(head);
+    static_cast<WlrOutput*>(data)->current.scale = scale;
+}
+
+void WlrListeners::headFinished(void* data, zwlr_output_head_v1* head)
+{
+    Q_UNUSED(head);
+    WlrOutput* output = static_cast<WlrOutput*>(data);
+    static_cast<WlrScreenResources*>(output->mParent)->removeHead(output);
+}
+
+void WlrListeners::headString(void* data, zwlr_output_head_v1* head, const char* value)
+{
+    // Make, model and serial number are not used:
+    Q_UNUSED(data);
+    Q_UNUSED(head);
+    Q_UNUSED(value);
+}
+
+void WlrListeners::headAdaptiveSync(void* data, zwlr_output_head_v1* head, uint32_t state)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(head);
+    Q_UNUSED(state);
+}
+
+void WlrListeners::modeSize(void* data, zwlr_output_mode_v1* mode, int32_t width, int32_t height)
+{
+    WlrOutput* output = static_cast<WlrOutput*>(data);
+    output->mModes[mode].size = QSize(width, height);
+}
+
+void WlrListeners::modeRefresh(void* data, zwlr_output_mode_v1* mode, int32_t refresh)
+{
+    WlrOutput* output = static_cast<WlrOutput*>(data);
+    output->mModes[mode].refresh = refresh;
+}
+
+void WlrListeners::modePreferred(void* data, zwlr_output_mode_v1* mode)
+{
+    WlrOutput* output = static_cast<WlrOutput*>(data);
+    output->mModes[mode].preferred = true;
+}
+
+void WlrListeners::modeFinished(void* data, zwlr_output_mode_v1* mode)
+{
+    WlrOutput* output = static_cast<WlrOutput*>(data);
+    output->mModes.remove(mode);
+    if (output->current.mode == mode)
+        output->current.mode = nullptr;
+    if (output->mLastMode == mode)
+        output->mLastMode = nullptr;
+    releaseMode(mode);
+}
+
+void WlrListeners::configurationSucceeded(void* data, zwlr_output_configuration_v1* configuration)
+{
+    configurationFinished(data, configuration, true);
+}
+
+void WlrListeners::configurationFailed(void* data, zwlr_output_configuration_v1* configuration)
+{
+    qWarning() << QObject::tr("The compositor rejected the output configuration");
+    configurationFinished(data, configuration, false);
+}
+
+void WlrListeners::configurationCancelled(void* data, zwlr_output_configuration_v1* configuration)
+{
+    qWarning() << QObject::tr("The output configuration was cancelled, because the outputs changed meanwhile");
+    configurationFinished(data, configuration, false);
+}
+
+void WlrListeners::configurationFinished(void* data, zwlr_output_configuration_v1* configuration, bool success)
+{
+    WlrScreenResources* resources = static_cast<WlrScreenResources*>(data);
+
+    QOperationCallback callback = resources->mConfigurations.take(configuration);
+    zwlr_output_configuration_v1_destroy(configuration);
+    wl_display_flush(resources->mDisplay);
+
+    if (callback)
+        callback(success);
+    // On failure, the head state received while the configuration was pending is the actual one:
+    if (!success && resources->mConfigurations.isEmpty())
+        resources->commitHeads();
+}
+
+void WlrListeners::releaseMode(zwlr_output_mode_v1* mode)
+{
+    if (zwlr_output_mode_v1_get_version(mode) >= ZWLR_OUTPUT_MODE_V1_RELEASE_SINCE_VERSION)
+        zwlr_output_mode_v1_release(mode);
+    else
+        zwlr_output_mode_v1_destroy(mode);
+}
+
+QScreenResources* WlrScreenResources::create(bool forceBackend)
+{
+    QTraceScope trace("connectWayland");
+    wl_display* display = wl_display_connect(nullptr);
+    if (display == nullptr) {
+        if (forceBackend)
+            qWarning() << QObject::tr("This backend only supports Wayland");
+        return nullptr;
+    }
+
+    WlrScreenResources* resources = new WlrScreenResources(display);
+    if ((resources->mManager == nullptr) || !resources->mInitialized) {
+        if (forceBackend)
+            qWarning() << QObject::tr("The compositor does not support wlroots output management");
+        delete resources;
+        return nullptr;
+    }
+    return resources;
+}
+
+WlrScreenResources::WlrScreenResources(wl_display* display)
+    : QTypedScreenResources<WlrOutput>(WlrScreenResources::name), mDisplay(display), mManager(nullptr), mManagerVersion(0),
+      mSerial(0), mInitialized(false), mNotifier(nullptr), mNextId(1)
+{
+    // Bind the output manager:
+    mRegistry = wl_display_get_registry(mDisplay);
+    wl_registry_add_listener(mRegistry, &WlrListeners::registry, this);
+    QStats::count("Roundtrip");
+    wl_display_roundtrip(mDisplay);
+    if (mManager == nullptr)
+        return;
+
+    // Retrieve the heads, their modes and the first serial:
+    QStats::count("Roundtrip");
+    wl_display_roundtrip(mDisplay);
+
+    // Keep the head state up to date:
+    mNotifier = new QSocketNotifier(wl_display_get_fd(mDisplay), QSocketNotifier::Read);
+    QObject::connect(mNotifier, &QSocketNotifier::activated, [this] {
+        dispatch();
+    });
+}
+
+WlrScreenResources::~WlrScreenResources(void)
+{
+    delete mNotifier;
+
+    for (auto it = mConfigurations.constBegin(); it != mConfigurations.constEnd(); it++)
+        zwlr_output_configuration_v1_destroy(it.key());
+    while (!mHeads.isEmpty())
+        removeHead(mHeads.first());
+    if (mManager != nullptr)
+        zwlr_output_manager_v1_destroy(mManager);
+    wl_registry_destroy(mRegistry);
+    wl_display_disconnect(mDisplay);
+}
+
+void WlrScreenResources::moveToThread(QThread* thread)
+{
+    if (mNotifier != nullptr)
+        mNotifier->moveToThread(thread);
+}
+
+void WlrScreenResources::refreshOutputs(void)
+{
+    QTraceScope trace("refreshOutputs");
+    QStatsOperation stats("refresh");
+
+    // The head state is live, only make sure that all the events are dispatched:
+    QStats::count("Roundtrip");
+    if (wl_display_roundtrip(mDisplay) < 0)
+        qWarning() << QObject::tr("The Wayland connection was lost");
+    updateNameIndex();
+}
+
+void WlrScreenResources::dispatch(void)
+{
+    // Read the events without blocking (the connection is readable):
+    while (wl_display_prepare_read(mDisplay) != 0)
+        wl_display_dispatch_pending(mDisplay);
+    wl_display_flush(mDisplay);
+    if (wl_display_read_events(mDisplay) < 0) {
+        qWarning() << QObject::tr("The Wayland connection was lost");
+        mNotifier->setEnabled(false);
+        return;
+    }
+    wl_display_dispatch_pending(mDisplay);
+}
+
+void WlrScreenResources::commitHeads(void)
+{
+    for (WlrOutput* output : mHeads) {
+        if (!mOutputs.contains(output->id))
+            mOutputs.insert(output);
+
+        // The enabled states are only changed by the pending configurations until they finish:
+        if (mConfigurations.isEmpty())
+            output->mEnabled = output->current.enabled;
+        if (output->mRect.isNull() && output->current.enabled)
+            output->mRect = output->rect(output->current);
+        mLayout.set(output->id, output->mRect, 0, true, output->mEnabled);
+    }
+    updateNameIndex();
+}
+
+void WlrScreenResources::removeHead(WlrOutput* output)
+{
+    for (auto it = output->mModes.constBegin(); it != output->mModes.constEnd(); it++)
+        WlrListeners::releaseMode(it.key());
+    output->mModes.clear();
+    if (zwlr_output_head_v1_get_version(output->mHead) >= ZWLR_OUTPUT_HEAD_V1_RELEASE_SINCE_VERSION)
+        zwlr_output_head_v1_release(output->mHead);
+    else
+        zwlr_output_head_v1_destroy(output->mHead);
+    mHeads.remove(output->mHead);
+
+    if (mOutputs.contains(output->id)) {
+        mLayout.remove(output->id);
+        mOutputs.take(output->id);
+    }
+    delete output;
+}
+
+bool WlrScreenResources::changeOutputStates(const QOutputChanges& states, QOutputChanges* oldStates)
+{
+    // All the outputs should exist:
+    for (auto it = states.constBegin(); it != states.constEnd(); it++) {
+        if (typedOutput(it.key()) == nullptr)
+            return false;
+    }
+
+    for (auto it = states.constBegin(); it != states.constEnd(); it++) {
+        WlrOutput* output = typedOutput(it.key());
+        if (oldStates != nullptr)
+            oldStates->insert(it.key(), output->mEnabled);
+
+        // The outputs which were never enabled are placed on the right of the screen:
+        if (it.value() && output->mRect.isNull()) {
+            WlrOutput::Config config = output->current;
+            config.mode = output->enableMode();
+            QRect totalScreen = mLayout.totalScreen();
+            config.position = totalScreen.isNull() ? QPoint(0, 0) : QPoint(totalScreen.right() + 1, totalScreen.top());
+            output->mRect = output->rect(config);
+            mLayout.set(output->id, output->mRect, 0, true, output->mEnabled);
+        }
+        output->setEnabled(it.value());
+    }
+
+    return true;
+}
+
+bool WlrScreenResources::planConfigs(QMap<WlrOutput*, WlrOutput::Config>* plan) const
+{
+    // Compute output offset:
+    QRect totalScreen = mLayout.totalScreen();
+    QRect newScreen = mLayout.screen();
+    if (newScreen.isNull())
+        return false;
+    QPoint offset = newScreen.topLeft() - totalScreen.topLeft();
+
+    // All the heads must be configured:
+    for (WlrOutput* output : mHeads) {
+        WlrOutput::Config config = output->current;
+        if (mOutputs.contains(output->id)) {
+            config.enabled = output->mEnabled;
+            if (config.enabled) {
+                config.mode = output->enableMode();
+                config.position = output->mRect.topLeft() - offset;
+            }
+        }
+        if (config.enabled && (config.mode == nullptr)) {
+            qWarning() << QObject::tr("No mode is available for output %1").arg(output->name);
+            return false;
+        }
+        plan->insert(output, config);
+    }
+    return true;
+}
+
+zwlr_output_configuration_v1* WlrScreenResources::sendConfiguration(const QMap<WlrOutput*, WlrOutput::Config>& plan, const QOperationCallback& callback)
+{
+    QString operation = QStats::currentOperation();
+    QElapsedTimer timer;
+    timer.start();
+    qint64 traceBegin = QTracer::isEnabled() ? QTracer::now() : 0;
+
+    zwlr_output_configuration_v1* configuration = zwlr_output_manager_v1_create_configuration(mManager, mSerial);
+    zwlr_output_configuration_v1_add_listener(configuration, &WlrListeners::configuration, this);
+    for (auto it = plan.constBegin(); it != plan.constEnd(); it++) {
+        if (!it.value().enabled) {
+            zwlr_output_configuration_v1_disable_head(configuration, it.key()->mHead);
+            continue;
+        }
+
+        zwlr_output_configuration_head_v1* head = zwlr_output_configuration_v1_enable_head(configuration, it.key()->mHead);
+        zwlr_output_configuration_head_v1_set_mode(head, it.value().mode);
+        zwlr_output_configuration_head_v1_set_position(head, it.value().position.x(), it.value().position.y());
+        zwlr_output_configuration_head_v1_set_transform(head, it.value().transform);
+        zwlr_output_configuration_head_v1_set_scale(head, it.value().scale);
+        // The head configurations are destroyed with the configuration:
+        zwlr_output_configuration_head_v1_destroy(head);
+    }
+    zwlr_output_configuration_v1_apply(configuration);
+    wl_display_flush(mDisplay);
+
+    mConfigurations.insert(configuration, [callback, operation, timer, traceBegin] (bool success) {
+        QStats::count(operation, "ApplyConfiguration", timer.nsecsElapsed());
+        if (QTracer::isEnabled())
+            QTracer::record("applyConfiguration", traceBegin, QTracer::now());
+        callback(success);
+    });
+    return configuration;
+}
+
+bool WlrScreenResources::waitConfiguration(zwlr_output_configuration_v1* configuration, const bool& finished)
+{
+    while (!finished) {
+        if (wl_display_dispatch(mDisplay) < 0) {
+            qWarning() << QObject::tr("The Wayland connection was lost");
+            mConfigurations.remove(configuration);
+            zwlr_output_configuration_v1_destroy(configuration);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WlrScreenResources::apply(const QOutputChanges& changes, bool grab)
+{
+    Q_UNUSED(grab);
+
+    if (mManager == nullptr)
+        return false;
+
+    // Update the output states:
+    QOutputChanges oldOutputStates;
+    if (!changeOutputStates(changes, &oldOutputStates))
+        return false;
+
+    // Apply them with a single configuration:
+    QMap<WlrOutput*, WlrOutput::Config> plan;
+    bool ans = false;
+    bool finished = false;
+    if (planConfigs(&plan)) {
+        zwlr_output_configuration_v1* configuration = sendConfiguration(plan, [&ans, &finished] (bool success) {
+            ans = success;
+            finished = true;
+        });
+        waitConfiguration(configuration, finished);
+    }
+    if (!ans)
+        changeOutputStates(oldOutputStates);
+    return ans;
+}
+
+void WlrScreenResources::applyAsync(const QOutputChanges& changes, bool grab, const QOperationCallback& callback)
+{
+    Q_UNUSED(grab);
+
+    if (mManager == nullptr) {
+        callback(false);
+        return;
+    }
+
+    // Update the output states:
+    QOutputChanges oldOutputStates;
+    if (!changeOutputStates(changes, &oldOutputStates)) {
+        callback(false);
+        return;
+    }
+
+    // Apply them with a single configuration:
+    QMap<WlrOutput*, WlrOutput::Config> plan;
+    if (!planConfigs(&plan)) {
+        changeOutputStates(oldOutputStates);
+        callback(false);
+        return;
+    }
+    sendConfiguration(plan, [this, oldOutputStates, callback] (bool success) {
+        if (!success)
+            changeOutputStates(oldOutputStates);
+        callback(success);
+    });
+}
+
+void WlrScreenResources::writeSnapshot(QDataStream& stream) const
+{
+    stream << (quint32) mHeads.size();
+    for (WlrOutput* output : mHeads) {
+        WlrOutput::Mode mode = output->mModes.value(output->current.enabled ? output->current.mode : output->enableMode());
+        stream << output->name << output->current.enabled << output->current.position
+               << mode.size << (qint32) mode.refresh << (qint32) output->current.transform << (qint32) output->current.scale;
+    }
+}
+
+bool WlrScreenResources::readSnapshot(QDataStream& stream)
+{
+    if (mManager == nullptr)
+        return false;
+
+    // Read the head configurations:
+    QMap<QString, WlrOutput::Config> configs;
+    QMap<QString, QPair<QSize, int> > modes;
+    quint32 outputCount = 0;
+    stream >> outputCount;
+    for (quint32 o = 0; (o < outputCount) && (stream.status() == QDataStream::Ok); o++) {
+        QString name;
+        WlrOutput::Config config;
+        QSize size;
+        qint32 refresh, transform, scale;
+        stream >> name >> config.enabled >> config.position >> size >> refresh >> transform >> scale;
+        config.transform = transform;
+        config.scale = scale;
+        configs.insert(name, config);
+        modes.insert(name, qMakePair(size, (int) refresh));
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << QObject::tr("Invalid snapshot");
+        return false;
+    }
+
+    // Match the heads by name and the modes by size and refresh rate:
+    QMap<WlrOutput*, WlrOutput::Config> plan;
+    for (WlrOutput* output : mHeads) {
+        WlrOutput::Config config = configs.value(output->name, output->current);
+        if (configs.contains(output->name)) {
+            config.mode = nullptr;
+            for (auto it = output->mModes.constBegin(); it != output->mModes.constEnd(); it++) {
+                if ((it.value().size == modes.value(output->name).first) && (it.value().refresh == modes.value(output->name).second)) {
+                    config.mode = it.key();
+                    break;
+                }
+            }
+            if (config.mode == nullptr)
+                config.mode = output->enableMode();
+        }
+        if (config.enabled && (config.mode == nullptr)) {
+            qWarning() << QObject::tr("No mode is available for output %1").arg(output->name);
+            return false;
+        }
+        plan.insert(output, config);
+    }
+
+    // Apply them with a single configuration:
+    bool ans = false;
+    bool finished = false;
+    zwlr_output_configuration_v1* configuration = sendConfiguration(plan, [&ans, &finished] (bool success) {
+        ans = success;
+        finished = true;
+    });
+    if (!waitConfiguration(configuration, finished) || !ans)
+        return false;
+
+    // Update the output states:
+    for (auto it = plan.constBegin(); it != plan.constEnd(); it++) {
+        if (mOutputs.contains(it.key()->id))
+            it.key()->setEnabled(it.value().enabled);
+    }
+    return true;
+}
@@ -0,0 +1,204 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef WLRSCREENRESOURCES_H
+#define WLRSCREENRESOURCES_H
+
+#include "qtypedscreenresources.h"
+#include "wlroutput.h"
+
+#include <QMap>
+
+struct wl_display;
+struct wl_registry;
+struct zwlr_output_manager_v1;
+struct zwlr_output_configuration_v1;
+
+class QSocketNotifier;
+
+/*!
+ * \brief Internal representation for wlroots output management
+ *
+ * This class holds the internal representation of the output heads
+ * advertised by a Wayland compositor implementing the \c zwlr_output_manager_v1 protocol
+ * (wlroots based compositors, such as Sway, Hyprland, Wayfire, labwc, ...).
+ * It also allows to enable and disable the outputs.
+ *
+ * The backend uses its own Wayland connection, so that it does not depend on the Qt platform.
+ * The head state is kept up to date by the protocol events, which are dispatched
+ * when the connection is readable, so that the changes can be applied without any query.
+ * Each change is applied with a single output configuration.
+ */
+class WlrScreenResources : public QTypedScreenResources<WlrOutput>
+{
+public:
+    static QString name;    /*!< Backend name */
+    /*!
+     * \brief Screen resources factory
+     *
+     * This method creates a new screen resource instance,
+     * if the backend matches.
+     * \param forceBackend Whether the backend name was specified.
+     * \return A new screen resources instance if the backend matches,
+     * otherwise, \c nullptr.
+     */
+    static QScreenResources* create(bool forceBackend);
+
+    /*!
+     * \brief Destructor
+     *
+     * Desallocates the internal data, releases the Wayland objects
+     * and closes the Wayland connection.
+     */
+    ~WlrScreenResources(void);
+protected:
+    /*!
+     * \brief Refresh the cached output list
+     *
+     * The head state is kept up to date by the protocol events,
+     * so this only dispatches the events which were not dispatched yet.
+     */
+    void refreshOutputs(void);
+    /*!
+     * \brief Apply output changes
+     *
+     * Apply the given output changes with a single output configuration
+     * and wait for the compositor to answer.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * \param grab This parameter is ignored in this implementation.
+     * \return Whether the changes were successfully applied.
+     */
+    bool apply(const QOutputChanges& changes, bool grab);
+    /*!
+     * \brief Apply output changes asynchronously
+     *
+     * Apply the given output changes with a single output configuration,
+     * without waiting for the compositor to answer.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * \param grab This parameter is ignored in this implementation.
+     * \param callback The function called with the result of the operation.
+     */
+    void applyAsync(const QOutputChanges& changes, bool grab, const QOperationCallback& callback);
+    /*!
+     * \brief Write a snapshot
+     *
+     * Write the configuration of each head to the given stream.
+     * \param stream The snapshot stream.
+     */
+    void writeSnapshot(QDataStream& stream) const;
+    /*!
+     * \brief Apply a snapshot
+     *
+     * Read the head configurations from the given stream
+     * and apply them with a single output configuration.
+     * The heads are matched by name and the modes by size and refresh rate.
+     * \param stream The snapshot stream.
+     * \return Whether the snapshot was applied.
+     */
+    bool readSnapshot(QDataStream& stream);
+    /*!
+     * \brief Move to another thread
+     *
+     * Move the notifier of the Wayland connection to the given thread.
+     * \param thread The thread which will use the screen resources.
+     */
+    void moveToThread(QThread* thread);
+private:
+    /*!
+     * \brief Constructor
+     *
+     * Bind the output manager and retrieve the initial head state.
+     * \param display The Wayland connection.
+     * \sa create()
+     */
+    WlrScreenResources(wl_display* display);
+    /*!
+     * \brief Change output states
+     *
+     * Change the enabled state of the given outputs, without applying it.
+     * The outputs which are enabled for the first time are placed on the right of the screen.
+     * \param states The new enabled state of the outputs, by output identifier.
+     * \param oldStates If not \c nullptr, filled with the previous enabled state of the outputs.
+     * \return Whether all the outputs exist. If not, the output states are left unchanged.
+     */
+    bool changeOutputStates(const QOutputChanges& states, QOutputChanges* oldStates = nullptr);
+    /*!
+     * \brief Plan the head configurations
+     *
+     * Compute the configuration of all the heads from the enabled state of the outputs,
+     * shifting the enabled outputs as in the other backends.
+     * \param plan Filled with the configuration of each head.
+     * \return Whether a valid configuration was found.
+     */
+    bool planConfigs(QMap<WlrOutput*, WlrOutput::Config>* plan) const;
+    /*!
+     * \brief Send an output configuration
+     *
+     * Create an output configuration with the given head configurations and apply it.
+     * The callback is called when the compositor answers.
+     * \param plan The configuration of each head.
+     * \param callback The function called with the result of the configuration.
+     * \return The output configuration object.
+     */
+    zwlr_output_configuration_v1* sendConfiguration(const QMap<WlrOutput*, WlrOutput::Config>& plan, const QOperationCallback& callback);
+    /*!
+     * \brief Wait for an output configuration
+     *
+     * Dispatch the Wayland events until the compositor answers to the given configuration.
+     * \param configuration The output configuration object.
+     * \param finished Set to \c true by the configuration callback.
+     * \return Whether the compositor answered.
+     */
+    bool waitConfiguration(zwlr_output_configuration_v1* configuration, const bool& finished);
+    /*!
+     * \brief Dispatch Wayland events
+     *
+     * Read and dispatch the pending Wayland events without blocking.
+     * This is called when the Wayland connection is readable.
+     */
+    void dispatch(void);
+    /*!
+     * \brief Commit the head state
+     *
+     * Called when the compositor has sent all the head changes.
+     * The new heads are added to the outputs and the layout is updated.
+     */
+    void commitHeads(void);
+    /*!
+     * \brief Remove a head
+     *
+     * Release the Wayland head object and remove the associated output.
+     * \param output The output associated with the head.
+     */
+    void removeHead(WlrOutput* output);
+
+    wl_display* mDisplay;                                                    /*!< The Wayland connection */
+    wl_registry* mRegistry;                                                  /*!< The Wayland registry */
+    zwlr_output_manager_v1* mManager;                                        /*!< The output manager */
+    uint32_t mManagerVersion;                                                /*!< The version of the bound output manager */
+    uint32_t mSerial;                                                        /*!< The serial of the current head state */
+    bool mInitialized;                                                       /*!< Whether the initial head state was received */
+    QSocketNotifier* mNotifier;                                              /*!< Watches the Wayland connection */
+    QMap<zwlr_output_head_v1*, WlrOutput*> mHeads;                           /*!< The outputs associated with the heads, including the new ones */
+    QMap<zwlr_output_configuration_v1*, QOperationCallback> mConfigurations; /*!< The callbacks of the pending output configurations */
+    QOutputId mNextId;                                                       /*!< The identifier of the next new output */
+
+    friend struct WlrListeners;
+};
+
+#endif // WLRSCREENRESOURCES_H
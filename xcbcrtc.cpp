@@ -0,0 +1,43 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "xcbcrtc.h"
+
+#include <QtDebug>
+
+#include <xcb/randr.h>
+
+XcbCrtc::XcbCrtc(XcbScreenResources *parent, xcb_randr_get_crtc_info_reply_t *info)
+    : mParent(parent)
+{
+    x = info != nullptr ? info->x : 0;
+    y = info != nullptr ? info->y : 0;
+    width = info != nullptr ? info->width : 0;
+    height = info != nullptr ? info->height : 0;
+    mode = info != nullptr ? info->mode : XCB_NONE;
+    rotation = info != nullptr ? info->rotation : XCB_RANDR_ROTATION_ROTATE_0;
+
+    outputs.clear();
+    if (info != nullptr) {
+        xcb_randr_output_t* infoOutputs = xcb_randr_get_crtc_info_outputs(info);
+        for (int o = 0; o < xcb_randr_get_crtc_info_outputs_length(info); o++)
+            outputs.append(infoOutputs[o]);
+    }
+
+    resetCurrent();
+}
@@ -0,0 +1,51 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef XCBCRTC_H
+#define XCBCRTC_H
+
+#include "randrcrtc.h"
+
+typedef struct xcb_randr_get_crtc_info_reply_t xcb_randr_get_crtc_info_reply_t;
+
+class XcbScreenResources;
+
+/*!
+ * \brief Internal representation for XCB RandR CRTC
+ *
+ * Instances of this class represent a CRTC (Cathode Ray Tube Controller)
+ * queried with XCB RandR.
+ */
+class XcbCrtc : public RandRCrtc
+{
+private:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the class with the given information.
+     * \param parent The parent screen resources.
+     * \param info The CRTC information reply from XCB RandR.
+     */
+    XcbCrtc(XcbScreenResources* parent, xcb_randr_get_crtc_info_reply_t* info);
+
+    XcbScreenResources* mParent;   /*!< The parent screen resources */
+
+    friend class XcbScreenResources;
+};
+
+#endif // XCBCRTC_H
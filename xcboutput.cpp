@@ -0,0 +1,54 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "xcboutput.h"
+#include "xcbscreenresources.h"
+
+#include <QtDebug>
+
+#include <xcb/randr.h>
+
+XcbOutput::XcbOutput(XcbScreenResources *parent, xcb_randr_output_t outputId, xcb_randr_get_output_info_reply_t *info)
+    : RandROutput(parent)
+{
+    id = outputId;
+    update(info);
+}
+
+void XcbOutput::update(xcb_randr_get_output_info_reply_t *info)
+{
+    physicalWidth = info != nullptr ? info->mm_width : 0;
+    physicalHeight = info != nullptr ? info->mm_height : 0;
+    name = info != nullptr ? QString::fromLocal8Bit(QByteArray(reinterpret_cast<const char*>(xcb_randr_get_output_info_name(info)),
+                                                               xcb_randr_get_output_info_name_length(info)))
+                           : QString();
+    if (info == nullptr)
+        connection = QOutput::Connection::Unknown;
+    else if (info->connection == XCB_RANDR_CONNECTION_DISCONNECTED)
+        connection = QOutput::Connection::Disconnected;
+    else if (info->connection == XCB_RANDR_CONNECTION_CONNECTED)
+        connection = QOutput::Connection::Connected;
+    else
+        connection = QOutput::Connection::Unknown;
+
+    // Keep the CRTC of disabled outputs to be able to enable them again:
+    if ((info != nullptr) && (info->crtc != XCB_NONE))
+        mCrtcId = info->crtc;
+
+    mEnabled = (info != nullptr) && (info->crtc != XCB_NONE) && (crtc() != nullptr);
+}
@@ -0,0 +1,59 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef XCBOUTPUT_H
+#define XCBOUTPUT_H
+
+#include "randroutput.h"
+
+typedef uint32_t xcb_randr_output_t;
+typedef struct xcb_randr_get_output_info_reply_t xcb_randr_get_output_info_reply_t;
+
+class XcbScreenResources;
+
+/*!
+ * \brief Internal representation for XCB RandR output
+ *
+ * Instances of this class represent an output (monitor, ...).
+ */
+class XcbOutput : public RandROutput
+{
+private:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the class with the given information.
+     * \param parent The parent screen resources.
+     * \param outputId The output identifier.
+     * \param info The output information reply from XCB RandR.
+     */
+    XcbOutput(XcbScreenResources* parent, xcb_randr_output_t outputId, xcb_randr_get_output_info_reply_t* info);
+    /*!
+     * \brief Update the output
+     *
+     * This function actualizes the properties of the output.
+     * \note The associated CRTC is kept when the output is disabled,
+     * so that it can be enabled again.
+     * \param info The output information reply from XCB RandR.
+     */
+    void update(xcb_randr_get_output_info_reply_t* info);
+
+    friend class XcbScreenResources;
+};
+
+#endif // XCBOUTPUT_H
@@ -0,0 +1,192 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "xcbscreenresources.h"
+#include "xcboutput.h"
+#include "xcbcrtc.h"
+#include "qstats.h"
+#include "qtracer.h"
+
+#if QT_VERSION >= 0x060000
+#   include <QtGui>
+#else // QT_VERSION
+#   include <QX11Info>
+#endif // QT_VERSION
+#include <QtDebug>
+
+#include <cstdlib>
+
+#include <xcb/xcb.h>
+#include <xcb/randr.h>
+
+QString XcbScreenResources::name = "XCB";
+
+QScreenResources* XcbScreenResources::create(bool forceBackend)
+{
+#if QT_VERSION >= 0x060000
+    QNativeInterface::QX11Application* x11App = qGuiApp->nativeInterface<QNativeInterface::QX11Application>();
+
+    if (x11App != nullptr)
+        return XcbScreenResources::getCurrent(x11App->connection());
+#else // QT_VERSION
+    if (QX11Info::isPlatformX11())
+        return XcbScreenResources::getCurrent(QX11Info::connection());
+#endif // QT_VERSION
+    if (forceBackend)
+        qWarning() << QObject::tr("This backend only supports X11");
+    return nullptr;
+}
+
+XcbScreenResources* XcbScreenResources::getCurrent(xcb_connection_t* connection)
+{
+    xcb_screen_t* screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+
+    // Send all the requests before waiting for any reply:
+    QStats::count("GetScreenResourcesCurrent");
+    xcb_randr_get_screen_resources_current_cookie_t cookie = xcb_randr_get_screen_resources_current(connection, screen->root);
+    QStats::count("GetScreenSizeRange");
+    xcb_randr_get_screen_size_range_cookie_t rangeCookie = xcb_randr_get_screen_size_range(connection, screen->root);
+    QStats::count("GetGeometry");
+    xcb_get_geometry_cookie_t geometryCookie = xcb_get_geometry(connection, screen->root);
+
+    xcb_randr_get_screen_resources_current_reply_t* resources = xcb_randr_get_screen_resources_current_reply(connection, cookie, nullptr);
+    xcb_randr_get_screen_size_range_reply_t* range = xcb_randr_get_screen_size_range_reply(connection, rangeCookie, nullptr);
+    xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(connection, geometryCookie, nullptr);
+
+    if (resources == nullptr) {
+        qWarning() << QObject::tr("Could not retrieve RandR screen resources");
+        free(range);
+        free(geometry);
+        return nullptr;
+    }
+
+    // The connection setup gives the resolution, the root window geometry gives the current size:
+    XcbScreenResources* xcbResources = new XcbScreenResources(connection, resources);
+    QSize size(screen->width_in_pixels, screen->height_in_pixels);
+    QSize sizeMM(screen->width_in_millimeters, screen->height_in_millimeters);
+    if (geometry != nullptr) {
+        if (!size.isEmpty())
+            sizeMM = QSize(qRound((qreal) geometry->width * screen->width_in_millimeters / screen->width_in_pixels),
+                           qRound((qreal) geometry->height * screen->height_in_millimeters / screen->height_in_pixels));
+        size = QSize(geometry->width, geometry->height);
+    }
+    if (range != nullptr)
+        xcbResources->initScreenSize(size, sizeMM, QSize(range->min_width, range->min_height), QSize(range->max_width, range->max_height));
+    else
+        xcbResources->initScreenSize(size, sizeMM, size, size);
+    free(range);
+    free(geometry);
+
+    return xcbResources;
+}
+
+XcbScreenResources::XcbScreenResources(xcb_connection_t *connection, xcb_randr_get_screen_resources_current_reply_t *resources)
+    : QTypedScreenResources<XcbOutput, RandRScreenResources>(XcbScreenResources::name), mResources(resources)
+{
+    mConnection = connection;
+    mRoot = xcb_setup_roots_iterator(xcb_get_setup(connection)).data->root;
+
+    // The plans are validated against the screen resources:
+    QList<xcb_randr_crtc_t> crtcIds;
+    xcb_randr_crtc_t* crtcs = xcb_randr_get_screen_resources_current_crtcs(mResources);
+    for (int c = 0; c < xcb_randr_get_screen_resources_current_crtcs_length(mResources); c++)
+        crtcIds.append(crtcs[c]);
+    QList<xcb_randr_output_t> outputIds;
+    xcb_randr_output_t* outputs = xcb_randr_get_screen_resources_current_outputs(mResources);
+    for (int o = 0; o < xcb_randr_get_screen_resources_current_outputs_length(mResources); o++)
+        outputIds.append(outputs[o]);
+    QHash<xcb_randr_mode_t, QSize> modeSizes;
+    xcb_randr_mode_info_t* modes = xcb_randr_get_screen_resources_current_modes(mResources);
+    for (int m = 0; m < xcb_randr_get_screen_resources_current_modes_length(mResources); m++)
+        modeSizes.insert(modes[m].id, QSize(modes[m].width, modes[m].height));
+    setResources(crtcIds, outputIds, modeSizes, mResources->config_timestamp);
+}
+
+XcbScreenResources::~XcbScreenResources(void)
+{
+    if (mResources != nullptr)
+        free(mResources);
+}
+
+void XcbScreenResources::refreshOutputs(void)
+{
+    QTraceScope trace("refreshOutputs");
+    QStatsOperation stats("refresh");
+    xcb_randr_output_t* outputIds = xcb_randr_get_screen_resources_current_outputs(mResources);
+    int outputCount = xcb_randr_get_screen_resources_current_outputs_length(mResources);
+
+    // Send all the output information requests before waiting for any reply:
+    QVector<xcb_randr_get_output_info_cookie_t> cookies(outputCount);
+    for (int o = 0; o < outputCount; o++) {
+        QStats::count("GetOutputInfo");
+        cookies[o] = xcb_randr_get_output_info(mConnection, outputIds[o], mResources->config_timestamp);
+    }
+
+    QVector<xcb_randr_get_output_info_reply_t*> infos(outputCount);
+    for (int o = 0; o < outputCount; o++)
+        infos[o] = xcb_randr_get_output_info_reply(mConnection, cookies[o], nullptr);
+
+    // Fetch all the missing CRTCs at once:
+    QList<xcb_randr_crtc_t> crtcIds;
+    foreach (xcb_randr_get_output_info_reply_t* info, infos) {
+        if ((info == nullptr) || (info->crtc == XCB_NONE))
+            continue;
+        if (!mCrtcs.contains(info->crtc) && !crtcIds.contains(info->crtc))
+            crtcIds.append(info->crtc);
+    }
+    fetchCrtcs(crtcIds);
+
+    // Update existing outputs and create new ones:
+    QSet<QOutputId> outputIdSet;
+    for (int o = 0; o < outputCount; o++) {
+        XcbOutput* xOutput = typedOutput(outputIds[o]);
+        if (xOutput != nullptr) {
+            xOutput->update(infos[o]);
+        } else {
+            xOutput = new XcbOutput(this, outputIds[o], infos[o]);
+            mOutputs.insert(xOutput);
+        }
+        outputIdSet.insert(outputIds[o]);
+        free(infos[o]);
+
+        // Only the outputs with a known CRTC are part of the layout:
+        RandRCrtc* crtc = mCrtcs.value(xOutput->mCrtcId, nullptr);
+        mLayout.set(outputIds[o], crtc != nullptr ? crtc->rect() : QRect(), 0, crtc != nullptr, xOutput->mEnabled);
+    }
+
+    // Remove deleted outputs:
+    removeOutputsExcept(outputIdSet);
+    updateNameIndex();
+}
+
+void XcbScreenResources::fetchCrtcs(const QList<xcb_randr_crtc_t>& crtcIds)
+{
+    QTraceScope trace("getCrtcInfo");
+    // Send all the CRTC information requests before waiting for any reply:
+    QVector<xcb_randr_get_crtc_info_cookie_t> cookies(crtcIds.size());
+    for (int c = 0; c < crtcIds.size(); c++) {
+        QStats::count("GetCrtcInfo");
+        cookies[c] = xcb_randr_get_crtc_info(mConnection, crtcIds.at(c), mResources->config_timestamp);
+    }
+
+    for (int c = 0; c < crtcIds.size(); c++) {
+        xcb_randr_get_crtc_info_reply_t* info = xcb_randr_get_crtc_info_reply(mConnection, cookies[c], nullptr);
+        mCrtcs.insert(crtcIds.at(c), new XcbCrtc(this, info));
+        free(info);
+    }
+}
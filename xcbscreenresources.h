@@ -0,0 +1,101 @@
+/* Copyright 2024 Pascal COMBES <pascom@orange.fr>
+ *
+ * This file is part of ShutdownMonitor.
+ *
+ * ShutdownMonitor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ShutdownMonitor is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ShutdownMonitor. If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef XCBSCREENRESOURCES_H
+#define XCBSCREENRESOURCES_H
+
+#include "randrscreenresources.h"
+#include "xcbcrtc.h"
+
+typedef uint32_t xcb_randr_crtc_t;
+typedef uint32_t xcb_randr_output_t;
+typedef struct xcb_connection_t xcb_connection_t;
+typedef struct xcb_randr_get_screen_resources_current_reply_t xcb_randr_get_screen_resources_current_reply_t;
+
+class XcbOutput;
+
+/*!
+ * \brief Internal representation for XCB RandR screen resources
+ *
+ * This class holds the internal representation for RandR screen resources
+ * retrieved through XCB. Contrary to the Xlib backend, all the requests
+ * of a refresh are sent before waiting for any reply,
+ * so that their latency does not grow with the number of outputs.
+ * The outputs are enabled and disabled by RandRScreenResources.
+ */
+class XcbScreenResources : public QTypedScreenResources<XcbOutput, RandRScreenResources>
+{
+public:
+    static QString name;    /*!< Backend name */
+    /*!
+     * \brief Screen resources factory
+     *
+     * This method creates a new screen resource instance,
+     * if the backend matches.
+     * \param forceBackend Whether the backend name was specified.
+     * \return A new screen resources instance if the backend matches,
+     * otherwise, \c nullptr.
+     */
+    static QScreenResources* create(bool forceBackend);
+    /*!
+     * \brief Retrieve XCB RandR screen resources
+     *
+     * Uses RandR 1.3 API to retrieve screen resources for the given connection.
+     * \param connection The XCB connection for which to retrieve screen resources.
+     * \return The screen resources to the given connection.
+     */
+    static XcbScreenResources* getCurrent(xcb_connection_t* connection);
+
+    /*!
+     * \brief Destructor
+     *
+     * Desallocates the internal data and releases the resources.
+     */
+    ~XcbScreenResources(void);
+private:
+    /*!
+     * \brief Constructor
+     *
+     * Initialize the class with the given information.
+     * \param connection The XCB connection.
+     * \param resources The screen resources reply from XCB RandR.
+     * \sa getCurrent()
+     */
+    XcbScreenResources(xcb_connection_t* connection, xcb_randr_get_screen_resources_current_reply_t* resources);
+
+    /*!
+     * \brief Refresh the cached output list
+     *
+     * Refresh the QList of output internal representations.
+     * All the output information requests are sent at once,
+     * and then all the missing CRTC information requests.
+     */
+    void refreshOutputs(void);
+    /*!
+     * \brief Fetch CRTCs
+     *
+     * Retrieve the information of the given CRTCs (Cathode Ray Tube Controller)
+     * sending all the requests before waiting for the replies.
+     * \param crtcIds The identifiers of the CRTCs to fetch.
+     */
+    void fetchCrtcs(const QList<xcb_randr_crtc_t>& crtcIds);
+
+    xcb_randr_get_screen_resources_current_reply_t* mResources; /*!< The associated screen resources */
+};
+
+#endif // XCBSCREENRESOURCES_H
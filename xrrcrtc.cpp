@@ -33,14 +33,31 @@ XRandRCrtc::XRandRCrtc(XRandRScreenResources *parent, XRRCrtcInfo *info)
     rotation = info != nullptr ? info->rotation : RR_Rotate_0;
 
     outputs.clear();
-    for (int o = 0; o < info->noutput; o++)
+    for (int o = 0; (info != nullptr) && (o < info->noutput); o++)
         outputs.append(info->outputs[o]);
+
+    resetCurrent();
 }
 
-QString XRandRCrtc::display(void) const
+void XRandRCrtc::update(XRRCrtcInfo *info)
 {
-    return QString("%1x%2+%3+%4").arg(width)
-                                 .arg(height)
-                                 .arg(x)
-                                 .arg(y);
+    current.x = info != nullptr ? info->x : 0;
+    current.y = info != nullptr ? info->y : 0;
+    current.mode = info != nullptr ? info->mode : None;
+    current.rotation = info != nullptr ? info->rotation : RR_Rotate_0;
+
+    current.outputs.clear();
+    for (int o = 0; (info != nullptr) && (o < info->noutput); o++)
+        current.outputs.append(info->outputs[o]);
+
+    // Keep the original state of disabled CRTCs to be able to enable them again:
+    if (!current.enabled())
+        return;
+    x = current.x;
+    y = current.y;
+    width = info->width;
+    height = info->height;
+    mode = current.mode;
+    rotation = current.rotation;
+    outputs = current.outputs;
 }
@@ -19,14 +19,8 @@
 #ifndef XRRCRTC_H
 #define XRRCRTC_H
 
-#include <QString>
-#include <QList>
-#include <QRect>
+#include "randrcrtc.h"
 
-typedef unsigned short Rotation;
-typedef unsigned long XID;
-typedef XID RRMode;
-typedef XID RROutput;
 typedef struct _XRRCrtcInfo XRRCrtcInfo;
 
 class XRandRScreenResources;
@@ -34,35 +28,11 @@ class XRandRScreenResources;
 /*!
  * \brief Internal representation for XrandR CRTC
  *
- * Instances of this class represent a CRTC (Cathode Ray Tube Controller).
- * In particular, they give the position of the CRTC buffer in the screen.
+ * Instances of this class represent a CRTC (Cathode Ray Tube Controller)
+ * queried with XrandR.
  */
-class XRandRCrtc
+class XRandRCrtc : public RandRCrtc
 {
-public:
-    int x;                      /*!< The x coordinate of the top left point of the CRTC on the screen */
-    int y;                      /*!< The y coordinate of the top left point of the CRTC on the screen */
-    unsigned int width;         /*!< The width of the CRTC */
-    unsigned int height;        /*!< The height of the CRTC */
-    RRMode mode;                /*!< The mode of the CRTC */
-    Rotation rotation;          /*!< The rotation of the CRTC */
-    QList<RROutput> outputs;    /*! The list of the associated outputs */
-
-    /*!
-     * \brief User-friendly name of this CRTC
-     *
-     * Returns a user-friendly name for the CRTC.
-     * \return A user-friendly name for the CRTC.
-     */
-    QString display(void) const;
-    /*!
-     * \brief CRTC rectangle
-     *
-     * Returns the rectangle that this CRTC spans on the screen.
-     * \return The rectange that this CRTC spans on the screen.
-     * \sa x, y, width, height
-     */
-    inline QRect rect(void) const {return QRect(x, y, width, height);}
 private:
     /*!
      * \brief Constructor
@@ -72,6 +42,16 @@ private:
      * \param info The CRTC information from XrandR.
      */
     XRandRCrtc(XRandRScreenResources* parent, XRRCrtcInfo* info);
+    /*!
+     * \brief Update the CRTC
+     *
+     * This function actualizes the current configuration of the CRTC,
+     * when it was changed by another client.
+     * The original CRTC state is also replaced, unless the CRTC is disabled,
+     * so that the CRTC can be enabled again.
+     * \param info The CRTC information from XrandR.
+     */
+    void update(XRRCrtcInfo* info);
 
     XRandRScreenResources* mParent;   /*!< The parent screen resources */
 
@@ -17,15 +17,20 @@
  */
 
 #include "xrroutput.h"
-#include "xrrcrtc.h"
 #include "xrrscreenresources.h"
 
 #include <QtDebug>
 
 #include <X11/extensions/Xrandr.h>
 
-XRandROutput::XRandROutput(XRandRScreenResources *parent, XRROutputInfo *info)
-    : QOutput(parent)
+XRandROutput::XRandROutput(XRandRScreenResources *parent, RROutput outputId, XRROutputInfo *info)
+    : RandROutput(parent)
+{
+    id = outputId;
+    update(info);
+}
+
+void XRandROutput::update(XRROutputInfo *info)
 {
     physicalWidth = info != nullptr ? info->mm_width : 0;
     physicalHeight = info != nullptr ? info->mm_height : 0;
@@ -38,27 +43,12 @@ XRandROutput::XRandROutput(XRandRScreenResources *parent, XRROutputInfo *info)
         connection = QOutput::Connection::Connected;
     else
         connection = QOutput::Connection::Unknown;
-    mCrtcId = info != nullptr ? info->crtc : None;
-
-    mEnabled = info != nullptr ? parent->crtc(info->crtc) != nullptr : false;
-}
-
-XRandRCrtc* XRandROutput::crtc(void) const
-{
-    XRandRScreenResources* parent = dynamic_cast<XRandRScreenResources*>(mParent);
-    if (parent == nullptr)
-        return nullptr;
-
-    return mCrtcId != None ? parent->crtc(mCrtcId): nullptr;
-}
 
-QString XRandROutput::display(void) const
-{
-    if (name.isNull() || (crtc() == nullptr))
-        return name;
+    // Keep the CRTC of disabled outputs to be able to enable them again:
+    if ((info != nullptr) && (info->crtc != None))
+        mCrtcId = info->crtc;
 
-    return QString("%1 (%2)").arg(name)
-                             .arg(crtc()->display());
+    mEnabled = (info != nullptr) && (info->crtc != None) && (crtc() != nullptr);
 }
 
 bool XRandROutput::enable(bool grab)
@@ -73,9 +63,5 @@ bool XRandROutput::disable(bool grab)
 
 bool XRandROutput::toggle(bool grab)
 {
-    if (mEnabled)
-        return mParent->disableOutput(this, grab);
-    else
-        return mParent->enableOutput(this, grab);
-
+    return mParent->toggleOutput(this, grab);
 }
@@ -19,42 +19,22 @@
 #ifndef XRROUTPUT_H
 #define XRROUTPUT_H
 
-#include "qoutput.h"
-#include <QString>
+#include "randroutput.h"
 
 typedef unsigned long XID;
 typedef XID RROutput;
-typedef XID RRCrtc;
 typedef struct _XRROutputInfo XRROutputInfo;
-typedef unsigned short Connection;
 
 class XRandRScreenResources;
-class XRandRCrtc;
 
 /*!
  * \brief Internal representation for XrandR output
  *
  * Instances of this class represent an output (monitor, ...).
  */
-class XRandROutput : public QOutput
+class XRandROutput : public RandROutput
 {
 public:
-    /*!
-     * \brief Associated CRTC
-     *
-     * Returns the internal representation of the CRTC (Cathode Ray Tube controler)
-     * associated with this controller.
-     * \return The associated CRTC.
-     */
-    XRandRCrtc* crtc(void) const;
-    /*!
-     * \brief User-friendly name of this output
-     *
-     * Returns a user-friendly name for the output.
-     * \return A user-friendly name for the output.
-     */
-    QString display(void) const;
-
     /*!
      * \brief Is enabled?
      *
@@ -98,11 +78,19 @@ private:
      *
      * Initialize the class with the given information.
      * \param parent The parent screen resources.
+     * \param outputId The output identifier.
      * \param info The output information from XrandR.
      */
-    XRandROutput(XRandRScreenResources* parent, XRROutputInfo* info);
-
-    RRCrtc mCrtcId;                 /*!< The id of the associated CRTC */
+    XRandROutput(XRandRScreenResources* parent, RROutput outputId, XRROutputInfo* info);
+    /*!
+     * \brief Update the output
+     *
+     * This function actualizes the properties of the output.
+     * \note The associated CRTC is kept when the output is disabled,
+     * so that it can be enabled again.
+     * \param info The output information from XrandR.
+     */
+    void update(XRROutputInfo* info);
 
     friend class XRandRScreenResources;
 };
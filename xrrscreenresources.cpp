@@ -19,202 +19,330 @@
 #include "xrrscreenresources.h"
 #include "xrroutput.h"
 #include "xrrcrtc.h"
+#include "qstats.h"
+#include "qtracer.h"
 
 #if QT_VERSION >= 0x060000
 #   include <QtGui>
 #else // QT_VERSION
 #   include <QX11Info>
 #endif // QT_VERSION
+#include <QSocketNotifier>
+#include <QTimer>
 #include <QtDebug>
 
 #include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/extensions/Xrandr.h>
 
 QString XRandRScreenResources::name = "X11";
 
 QScreenResources* XRandRScreenResources::create(bool forceBackend)
 {
+    // Find the X display used by Qt:
+    QByteArray displayName;
 #if QT_VERSION >= 0x060000
     QNativeInterface::QX11Application* x11App = qGuiApp->nativeInterface<QNativeInterface::QX11Application>();
 
     if (x11App != nullptr)
-        return XRandRScreenResources::getCurrent(x11App->display());
+        displayName = DisplayString(x11App->display());
 #else // QT_VERSION
     if (QX11Info::isPlatformX11())
-        return XRandRScreenResources::getCurrent(QX11Info::display());
+        displayName = DisplayString(QX11Info::display());
 #endif // QT_VERSION
-    if (forceBackend)
-        qWarning() << QObject::tr("This backend only supports X11");
-    return nullptr;
+    if (displayName.isNull()) {
+        if (forceBackend)
+            qWarning() << QObject::tr("This backend only supports X11");
+        return nullptr;
+    }
+
+    // Open a private connection, which can be used from any thread (see initThreads()):
+    QStats::count("OpenDisplay");
+    Display* display = XOpenDisplay(displayName.constData());
+    if (display == nullptr) {
+        qWarning() << QObject::tr("Could not open X display %1").arg(QString::fromLocal8Bit(displayName));
+        return nullptr;
+    }
+    return XRandRScreenResources::getCurrent(display);
+}
+
+void XRandRScreenResources::initThreads(void)
+{
+    if (!XInitThreads())
+        qWarning() << QObject::tr("Could not initialize Xlib thread support");
 }
 
 XRandRScreenResources* XRandRScreenResources::get(Display* display)
 {
     Window root = DefaultRootWindow(display);
+    QStats::count("GetScreenResources");
     return new XRandRScreenResources(display, XRRGetScreenResources(display, root));
 }
 
 XRandRScreenResources* XRandRScreenResources::getCurrent(Display* display)
 {
     Window root = DefaultRootWindow(display);
+    QStats::count("GetScreenResourcesCurrent");
     return new XRandRScreenResources(display, XRRGetScreenResourcesCurrent(display, root));
 }
 
 XRandRScreenResources::XRandRScreenResources(Display *display, XRRScreenResources *resources)
-    : QScreenResources(XRandRScreenResources::name), mDisplay(display), mResources(resources)
-{}
+    : QTypedScreenResources<XRandROutput, RandRScreenResources>(XRandRScreenResources::name), mDisplay(display), mResources(resources), mScreenChanged(false)
+{
+    // The CRTCs are configured on the XCB connection underlying the display:
+    mConnection = XGetXCBConnection(mDisplay);
+    mRoot = DefaultRootWindow(mDisplay);
+    updateResources();
+
+    // Retrieve the screen size and its valid range:
+    int screen = DefaultScreen(mDisplay);
+    int minWidth, minHeight, maxWidth, maxHeight;
+    QSize size(DisplayWidth(mDisplay, screen), DisplayHeight(mDisplay, screen));
+    QSize sizeMM(DisplayWidthMM(mDisplay, screen), DisplayHeightMM(mDisplay, screen));
+    QStats::count("GetScreenSizeRange");
+    if (XRRGetScreenSizeRange(mDisplay, DefaultRootWindow(mDisplay), &minWidth, &minHeight, &maxWidth, &maxHeight))
+        initScreenSize(size, sizeMM, QSize(minWidth, minHeight), QSize(maxWidth, maxHeight));
+    else
+        initScreenSize(size, sizeMM, size, size);
+
+    // Coalesce the changes until the next event loop iteration:
+    mChangeTimer = new QTimer();
+    mChangeTimer->setSingleShot(true);
+    mChangeTimer->setInterval(0);
+    QObject::connect(mChangeTimer, &QTimer::timeout, [this] {
+        processChanges();
+    });
+
+    // Listen to RandR notify events on the private connection:
+    int errorBase;
+    if (XRRQueryExtension(mDisplay, &mEventBase, &errorBase)) {
+        XRRSelectInput(mDisplay, DefaultRootWindow(mDisplay), RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+        XFlush(mDisplay);
+        mNotifier = new QSocketNotifier(ConnectionNumber(mDisplay), QSocketNotifier::Read);
+        QObject::connect(mNotifier, &QSocketNotifier::activated, [this] {
+            readEvents();
+        });
+    } else {
+        qWarning() << QObject::tr("Could not query RandR extension. Changes will not be tracked.");
+        mEventBase = -1;
+        mNotifier = nullptr;
+    }
+}
 
 XRandRScreenResources::~XRandRScreenResources(void)
 {
-    qDeleteAll(mCrtcs);
+    delete mNotifier;
+    delete mChangeTimer;
 
     if (mResources != nullptr)
         XRRFreeScreenResources(mResources);
+    XCloseDisplay(mDisplay);
 }
 
 void XRandRScreenResources::refreshOutputs(void)
 {
-    qDeleteAll(mOutputs);
+    QTraceScope trace("refreshOutputs");
+    QStatsOperation stats("refresh");
+    QSet<QOutputId> outputIds;
 
+    // Update existing outputs and create new ones:
     for (int o = 0; o < mResources->noutput; o++) {
-        XRROutputInfo* info = XRRGetOutputInfo(mDisplay, mResources, mResources->outputs[o]);
-        mOutputs.insert(mResources->outputs[o], new XRandROutput(this, info));
-        XRRFreeOutputInfo(info);
+        updateOutput(mResources->outputs[o]);
+        outputIds.insert(mResources->outputs[o]);
     }
+
+    // Remove deleted outputs:
+    removeOutputsExcept(outputIds);
+    updateNameIndex();
+
+    // The events read while waiting for the replies do not wake the notifier:
+    readEvents();
 }
 
-XRandRCrtc* XRandRScreenResources::crtc(RRCrtc crtcId)
+void XRandRScreenResources::updateOutput(RROutput outputId)
 {
-    if (crtcId == None)
-        return nullptr;
-    if (!mCrtcs.contains(crtcId)) {
-        XRRCrtcInfo* info = XRRGetCrtcInfo(mDisplay, mResources, crtcId);
-        mCrtcs.insert(crtcId, new XRandRCrtc(this, info));
-        XRRFreeCrtcInfo(info);
+    QStats::count("GetOutputInfo");
+    XRROutputInfo* info = XRRGetOutputInfo(mDisplay, mResources, outputId);
+    XRandROutput* xOutput = typedOutput(outputId);
+    if (xOutput != nullptr) {
+        xOutput->update(info);
+    } else {
+        xOutput = new XRandROutput(this, outputId, info);
+        mOutputs.insert(xOutput);
     }
-    return mCrtcs.value(crtcId);
-}
+    XRRFreeOutputInfo(info);
 
-bool XRandRScreenResources::enableOutput(QOutput *output, bool grab)
-{
-    // Cast output to internal type:
-    XRandROutput* xOutput = dynamic_cast<XRandROutput*>(output);
-    if (xOutput == nullptr)
-        return false;
-
-    // The output is already enabled:
-    if (xOutput->mEnabled)
-        return true;
-    // The output CRTC should be in the CRTC map:
-    if (!mCrtcs.contains(xOutput->mCrtcId))
-        return false;
-
-    // Update the CRTCs:
-    bool ans = true;
-    bool oldOutputState = xOutput->mEnabled;
-    xOutput->mEnabled = true;
-    QRect totalScreen = computeTotalScreen();
-    QRect newScreen = computeScreen();
-    if (grab)
-        XGrabServer(mDisplay);
-    for (auto it = mCrtcs.constBegin(); it != mCrtcs.constEnd(); it++)
-        ans &= updateCrtcOrigin(it.key(), it.value()->rect().topLeft() - newScreen.topLeft() + totalScreen.topLeft());
-    if (grab)
-        XUngrabServer(mDisplay);
-    if (!ans)
-        xOutput->mEnabled = oldOutputState;
-    return ans;
+    // Only the outputs with a known CRTC are part of the layout:
+    RandRCrtc* crtc = mCrtcs.value(xOutput->mCrtcId, nullptr);
+    mLayout.set(outputId, crtc != nullptr ? crtc->rect() : QRect(), 0, crtc != nullptr, xOutput->mEnabled);
 }
 
-bool XRandRScreenResources::disableOutput(QOutput *output, bool grab)
+void XRandRScreenResources::updateCrtc(RRCrtc crtcId)
 {
-    // Cast output to internal type:
-    XRandROutput* xOutput = dynamic_cast<XRandROutput*>(output);
-    if (xOutput == nullptr)
-        return false;
-
-    // The output is already disabled:
-    if (!xOutput->mEnabled)
-        return true;
-    // The output CRTC should be in the CRTC map:
-    if (!mCrtcs.contains(xOutput->mCrtcId))
-        return false;
-
-    // Update the CRTCs:
-    bool ans = true;
-    bool oldOutputState = xOutput->mEnabled;
-    xOutput->mEnabled = false;
-    QRect totalScreen = computeTotalScreen();
-    QRect newScreen = computeScreen();
-    if (newScreen.isNull()) {
-        xOutput->mEnabled = true;
-        return false;
+    // The CRTCs are only created by this backend:
+    XRandRCrtc* crtc = static_cast<XRandRCrtc*>(mCrtcs.value(crtcId, nullptr));
+    if (crtc == nullptr)
+        return;
+
+    QTraceScope trace("getCrtcInfo");
+    QStats::count("GetCrtcInfo");
+    XRRCrtcInfo* info = XRRGetCrtcInfo(mDisplay, mResources, crtcId);
+    crtc->update(info);
+    XRRFreeCrtcInfo(info);
+
+    // The outputs of the CRTC follow its new original state in the layout:
+    for (XRandROutput* xOutput : typedOutputs()) {
+        if (xOutput->mCrtcId == crtcId)
+            mLayout.set(xOutput->id, crtc->rect(), 0, true, xOutput->mEnabled);
     }
-    if (grab)
-        XGrabServer(mDisplay);
-    for (auto it = mCrtcs.constBegin(); it != mCrtcs.constEnd(); it++)
-        ans &= updateCrtcOrigin(it.key(), it.value()->rect().topLeft() - newScreen.topLeft() + totalScreen.topLeft());
-    if (grab)
-        XUngrabServer(mDisplay);
-    if (!ans)
-        xOutput->mEnabled = oldOutputState;
-    return ans;
 }
 
-QRect XRandRScreenResources::computeTotalScreen(void) const
+void XRandRScreenResources::readEvents(void)
 {
-    QRect screen;
-    foreach (QOutput* output, mOutputs) {
-        XRandROutput* xOutput = dynamic_cast<XRandROutput*>(output);
-        if (xOutput == nullptr)
-            continue;
-        if (!mCrtcs.contains(xOutput->mCrtcId))
+    bool changed = false;
+
+    // The replies may already have read the events from the socket:
+    while (XPending(mDisplay) > 0) {
+        XEvent event;
+        XNextEvent(mDisplay, &event);
+        XRRUpdateConfiguration(&event);
+
+        if (event.type == mEventBase + RRScreenChangeNotify) {
+            // Only a new configuration timestamp means that the resources changed:
+            XRRScreenChangeNotifyEvent* screenEvent = reinterpret_cast<XRRScreenChangeNotifyEvent*>(&event);
+            mScreenSize = QSize(screenEvent->width, screenEvent->height);
+            mScreenSizeMM = QSize(screenEvent->mwidth, screenEvent->mheight);
+            if (screenEvent->config_timestamp == mResources->configTimestamp)
+                continue;
+            mScreenChanged = true;
+        } else if (event.type == mEventBase + RRNotify) {
+            XRRNotifyEvent* notifyEvent = reinterpret_cast<XRRNotifyEvent*>(&event);
+            if (notifyEvent->subtype == RRNotify_CrtcChange) {
+                // Ignore the changes which are already known (e.g. the ones made by this backend):
+                XRRCrtcChangeNotifyEvent* crtcEvent = reinterpret_cast<XRRCrtcChangeNotifyEvent*>(&event);
+                RandRCrtc* crtc = mCrtcs.value(crtcEvent->crtc, nullptr);
+                if (crtc == nullptr)
+                    continue;
+                if ((crtcEvent->mode == None) && !crtc->current.enabled())
+                    continue;
+                if ((crtcEvent->mode == crtc->current.mode) && (crtcEvent->rotation == crtc->current.rotation)
+                 && (crtcEvent->x == crtc->current.x) && (crtcEvent->y == crtc->current.y))
+                    continue;
+                mChangedCrtcs.insert(crtcEvent->crtc);
+            } else if (notifyEvent->subtype == RRNotify_OutputChange) {
+                // Ignore the changes which are already known (e.g. the ones made by this backend):
+                XRROutputChangeNotifyEvent* outputEvent = reinterpret_cast<XRROutputChangeNotifyEvent*>(&event);
+                XRandROutput* xOutput = typedOutput(outputEvent->output);
+                if (xOutput != nullptr) {
+                    QOutput::Connection connection;
+                    if (outputEvent->connection == RR_Disconnected)
+                        connection = QOutput::Connection::Disconnected;
+                    else if (outputEvent->connection == RR_Connected)
+                        connection = QOutput::Connection::Connected;
+                    else
+                        connection = QOutput::Connection::Unknown;
+                    RRCrtc crtcId = xOutput->mEnabled ? xOutput->mCrtcId : None;
+                    if ((connection == xOutput->connection) && (outputEvent->crtc == crtcId))
+                        continue;
+                }
+                mChangedOutputs.insert(outputEvent->output);
+            } else {
+                continue;
+            }
+        } else {
             continue;
-        screen |= mCrtcs.value(xOutput->mCrtcId)->rect();
+        }
+        changed = true;
     }
-    return screen;
+
+    if (changed && !mChangeTimer->isActive())
+        mChangeTimer->start();
 }
 
-QRect XRandRScreenResources::computeScreen(void) const
+void XRandRScreenResources::processChanges(void)
 {
-    QRect screen;
-    foreach (QOutput* output, mOutputs) {
-        XRandROutput* xOutput = dynamic_cast<XRandROutput*>(output);
-        if (xOutput == nullptr)
-            continue;
-        if (!mCrtcs.contains(xOutput->mCrtcId))
-            continue;
-        if (xOutput->mEnabled)
-            screen |= mCrtcs.value(xOutput->mCrtcId)->rect();
+    QStatsOperation stats("refresh");
+
+    // Retrieve the new screen resources and find the added and removed outputs:
+    if (mScreenChanged) {
+        QStats::count("GetScreenResourcesCurrent");
+        XRRScreenResources* resources = XRRGetScreenResourcesCurrent(mDisplay, DefaultRootWindow(mDisplay));
+        if (resources != nullptr) {
+            XRRFreeScreenResources(mResources);
+            mResources = resources;
+            updateResources();
+
+            QSet<QOutputId> outputIds;
+            for (int o = 0; o < mResources->noutput; o++) {
+                outputIds.insert(mResources->outputs[o]);
+                if (!mOutputs.contains(mResources->outputs[o]))
+                    mChangedOutputs.insert(mResources->outputs[o]);
+            }
+            removeOutputsExcept(outputIds);
+        }
+        mScreenChanged = false;
+    }
+
+    // Update the changed CRTCs and then the changed outputs:
+    foreach (RRCrtc crtcId, mChangedCrtcs)
+        updateCrtc(crtcId);
+    foreach (RROutput outputId, mChangedOutputs) {
+        for (int o = 0; o < mResources->noutput; o++) {
+            if (mResources->outputs[o] == outputId) {
+                updateOutput(outputId);
+                break;
+            }
+        }
     }
-    return screen;
+
+    mChangedCrtcs.clear();
+    mChangedOutputs.clear();
+    updateNameIndex();
+
+    // The events read while waiting for the replies do not wake the notifier:
+    readEvents();
+}
+
+bool XRandRScreenResources::apply(const QOutputChanges& changes, bool grab)
+{
+    bool ans = RandRScreenResources::apply(changes, grab);
+
+    // The events read while waiting for the replies do not wake the notifier:
+    readEvents();
+    return ans;
+}
+
+void XRandRScreenResources::moveToThread(QThread* thread)
+{
+    mChangeTimer->moveToThread(thread);
+    if (mNotifier != nullptr)
+        mNotifier->moveToThread(thread);
 }
 
-bool XRandRScreenResources::updateCrtcOrigin(RRCrtc crtcId, const QPoint& newOrigin)
+void XRandRScreenResources::fetchCrtcs(const QList<xcb_randr_crtc_t>& crtcIds)
 {
-    // Get the CRTC internal representation:
-    XRandRCrtc* crtc = mCrtcs.value(crtcId);
-
-    // Get the associated enabled outputs:
-    QList<RROutput> crtcOutputs = crtc->outputs;
-    for (auto it = crtcOutputs.begin(); it != crtcOutputs.end();) {
-        XRandROutput* o = dynamic_cast<XRandROutput*>(output(*it));
-        if ((o == nullptr) || !o->mEnabled)
-            it = crtcOutputs.erase(it);
-        else
-            it++;
+    QTraceScope trace("getCrtcInfo");
+    foreach (xcb_randr_crtc_t crtcId, crtcIds) {
+        QStats::count("GetCrtcInfo");
+        XRRCrtcInfo* info = XRRGetCrtcInfo(mDisplay, mResources, crtcId);
+        mCrtcs.insert(crtcId, new XRandRCrtc(this, info));
+        XRRFreeCrtcInfo(info);
     }
+}
 
-    // Update the CRTC origin or disable it if there is not any associated enabled output:
-    Status s;
-    QVector<RROutput> outputs = QVector<RROutput>::fromList(crtcOutputs);
-    if (outputs.isEmpty())
-        s = XRRSetCrtcConfig(mDisplay, mResources, crtcId, CurrentTime,
-                             0, 0, None, RR_Rotate_0, NULL, 0);
-    else
-        s = XRRSetCrtcConfig(mDisplay, mResources, crtcId, CurrentTime,
-                             newOrigin.x(), newOrigin.y(), crtc->mode, crtc->rotation,
-                             outputs.data(), outputs.size());
+void XRandRScreenResources::updateResources(void)
+{
+    if (mResources == nullptr)
+        return;
 
-    return (s == RRSetConfigSuccess);
+    QList<xcb_randr_crtc_t> crtcIds;
+    for (int c = 0; c < mResources->ncrtc; c++)
+        crtcIds.append(mResources->crtcs[c]);
+    QList<xcb_randr_output_t> outputIds;
+    for (int o = 0; o < mResources->noutput; o++)
+        outputIds.append(mResources->outputs[o]);
+    QHash<xcb_randr_mode_t, QSize> modeSizes;
+    for (int m = 0; m < mResources->nmode; m++)
+        modeSizes.insert(mResources->modes[m].id, QSize(mResources->modes[m].width, mResources->modes[m].height));
+    setResources(crtcIds, outputIds, modeSizes, mResources->configTimestamp);
 }
@@ -19,8 +19,10 @@
 #ifndef XRRSCREENRESOURCES_H
 #define XRRSCREENRESOURCES_H
 
-#include "qscreenresources.h"
-#include <QMap>
+#include "randrscreenresources.h"
+#include "xrrcrtc.h"
+
+#include <QSet>
 
 typedef unsigned long XID;
 typedef XID RRCrtc;
@@ -29,17 +31,23 @@ typedef struct _XDisplay Display;
 typedef struct _XRRScreenResources XRRScreenResources;
 
 class XRandROutput;
-class XRandRCrtc;
-class QPoint;
-class QRect;
+class QSocketNotifier;
+class QTimer;
 
 /*!
  * \brief Internal reprsentation for XrandR screen resources
  *
  * This class holds the internal representation for XRandR screen resources.
  * It also allows to enable and disable the outputs.
+ *
+ * The backend uses its own X connection (opened with thread support), instead of the Qt one,
+ * so that it can be used from a backend thread (see QScreenResourcesWorker).
+ * The internal representation is kept up to date using RandR notify events,
+ * which are received on this connection. The changes are coalesced
+ * and only the affected outputs and CRTCs are queried again.
+ * The outputs are enabled and disabled by RandRScreenResources, on the XCB connection underlying the display.
  */
-class XRandRScreenResources : public QScreenResources
+class XRandRScreenResources : public QTypedScreenResources<XRandROutput, RandRScreenResources>
 {
 public:
     static QString name;    /*!< Backend name */
@@ -47,16 +55,26 @@ public:
      * \brief Screen resources factory
      *
      * This method creates a new screen resource instance,
-     * if the backend matches.
+     * if the backend matches. A new connection to the X display used by Qt is opened.
      * \param forceBackend Whether the backend name was specified.
      * \return A new screen resources instance if the backend matches,
      * otherwise, \c nullptr.
      */
     static QScreenResources* create(bool forceBackend);
+    /*!
+     * \brief Initialize Xlib thread support
+     *
+     * Enable the thread support of Xlib, so that the screen resources can be used
+     * from a backend thread (see QScreenResourcesWorker).
+     * \note This must be the first Xlib call of the process,
+     * hence it must be called before the application is created.
+     */
+    static void initThreads(void);
     /*!
      * \brief Retrieve XRandR screen resources
      *
      * Uses XrandR 1.2 API to retrieve screen resources for the given display.
+     * The screen resources take the ownership of the display, which is closed when they are destroyed.
      * \param display The X display for which to retrieve screen resources.
      * \return The screen resources to the given display.
      * \sa getCurrent()
@@ -66,6 +84,7 @@ public:
      * \brief Retrieve XRandR screen resources
      *
      * Uses XrandR 1.3 API to retrieve screen resources for the given display.
+     * The screen resources take the ownership of the display, which is closed when they are destroyed.
      * \param display The X display for which to retrieve screen resources.
      * \return The screen resources to the given display.
      * \sa get()
@@ -78,36 +97,6 @@ public:
      * Desallocates the internal data and releases the resources.
      */
     ~XRandRScreenResources(void);
-
-    /*!
-     * \brief Get a CRTC
-     *
-     * Get a pointer to the corresponding CRTC (Cathode Ray Tube Controller) internal reprsentation.
-     * \param crtcId The desired CRTC identifier.
-     * \return The CRTC internal representation corresponding to the given identifier.
-     */
-    XRandRCrtc* crtc(RRCrtc crtcId);
-
-    /*!
-     * \brief Enable the given output
-     *
-     * Enable the given output.
-     * \param output The output to enable.
-     * \param grab Whether to grab the X display.
-     * \return Whether this output was successfully enabled.
-     * \sa disableOutput()
-     */
-    bool enableOutput(QOutput* output, bool grab = false);
-    /*!
-     * \brief Disable the given output
-     *
-     * Disable the given output.
-     * \param output The output to disable.
-     * \param grab Whether to grab the X display.
-     * \return Whether this output was successfully disabled.
-     * \sa enableOutput()
-     */
-    bool disableOutput(QOutput* output, bool grab = false);
 private:
     /*!
      * \brief Constructor
@@ -126,36 +115,81 @@ private:
      */
     void refreshOutputs(void);
     /*!
-     * \brief Compute total screen
+     * \brief Update an output
      *
-     * Compute the screen rectangle when all outputs are on.
-     * \return The total screen rectangle
-     * \sa computeScreen()
+     * Query the information of the given output and update its internal representation,
+     * or create it if it does not exist yet.
+     * \param outputId The identifier of the output to update.
+     * \sa updateCrtc()
      */
-    QRect computeTotalScreen(void) const;
+    void updateOutput(RROutput outputId);
     /*!
-     * \brief Compute screen
+     * \brief Update a CRTC
      *
-     * Compute the screen rectangle when only enabled outputs are on.
-     * \return The screen rectangle
-     * \sa computeTotalScreen()
+     * Query the information of the given CRTC (Cathode Ray Tube Controller), if it is cached,
+     * and update its configuration and the layout of its outputs.
+     * \note Only the changes made by other clients are processed (see readEvents()),
+     * hence they also replace the original CRTC state.
+     * \param crtcId The identifier of the CRTC to update.
+     * \sa updateOutput()
      */
-    QRect computeScreen(void) const;
+    void updateCrtc(RRCrtc crtcId);
     /*!
-     * \brief Update a CRTC origin
+     * \brief Read the X events
      *
-     * Update the top left point of a CRTC (Cathode Ray Tube Controller) rectangle.
-     * Also update the associated outputs. The CRTC is disabled
-     * if there is not any associated enabled output.
-     * \param crtcId The identifier of the CRTC to update.
-     * \param newOrigin The new coordinates of the CRTC top left point.
-     * \return Whether the CRTC origin was successfully updated.
+     * Read the pending events of the X connection, and record the outputs and CRTCs
+     * affected by RandR notify events. The changes are processed on the next event loop iteration.
+     * \sa processChanges()
+     */
+    void readEvents(void);
+    /*!
+     * \brief Process the recorded changes
+     *
+     * Update the internal representation of the outputs and CRTCs
+     * affected by the RandR notify events received since the last call.
+     * \sa readEvents()
+     */
+    void processChanges(void);
+    /*!
+     * \brief Apply output changes
+     *
+     * Apply the given output changes with RandRScreenResources::apply()
+     * and read the events received while waiting for the replies.
+     * \param changes The new enabled state of the outputs, by output identifier.
+     * \param grab Whether to grab the X display.
+     * \return Whether the changes were successfully applied.
+     */
+    bool apply(const QOutputChanges& changes, bool grab);
+    /*!
+     * \brief Move to another thread
+     *
+     * Move the change timer and the notifier of the X connection to the given thread.
+     * \param thread The thread which will use the screen resources.
+     */
+    void moveToThread(QThread* thread);
+    /*!
+     * \brief Fetch CRTCs
+     *
+     * Query the information of the given CRTCs (Cathode Ray Tube Controller) with XrandR.
+     * \param crtcIds The identifiers of the CRTCs to fetch.
      */
-    bool updateCrtcOrigin(RRCrtc crtcId, const QPoint& newOrigin);
+    void fetchCrtcs(const QList<xcb_randr_crtc_t>& crtcIds);
+    /*!
+     * \brief Update the screen resources
+     *
+     * Give the CRTCs, outputs and modes of the XRandR screen resources to RandRScreenResources.
+     */
+    void updateResources(void);
 
     Display* mDisplay;                  /*!< The associated X display */
     XRRScreenResources* mResources;     /*!< The associated screen resources */
-    QMap<RRCrtc, XRandRCrtc*> mCrtcs;   /*!< The map of CRTC internal representations */
+
+    int mEventBase;                     /*!< The RandR event base */
+    QSocketNotifier* mNotifier;         /*!< The notifier of the X connection */
+    QTimer* mChangeTimer;               /*!< The timer used to coalesce the RandR notify events */
+    bool mScreenChanged;                /*!< Whether the screen resources changed */
+    QSet<RROutput> mChangedOutputs;     /*!< The outputs which changed */
+    QSet<RRCrtc> mChangedCrtcs;         /*!< The CRTCs which changed */
 };
 
 #endif // XRRSCREENRESOURCES_H